@@ -19,6 +19,8 @@
 
 #include <stdlib.h>
 
+#include "alloc.h"
+
 void *ommalloc(size_t size) {
     void *ptr = malloc(size);
     if (!ptr) {
@@ -57,3 +59,80 @@ void *omrealloc(void *ptr, size_t new_size) {
     }
     return ptr;
 }
+
+// enough for any type the game stores (including SIMD vectors)
+#define ARENA_ALIGN ((size_t)16)
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct ArenaBlock {
+    ArenaBlock *next;
+    unsigned char *data;
+    size_t size;
+    size_t used;
+};
+
+void Arena_Init(Arena *arena, size_t blockSize) {
+    arena->head = NULL;
+    arena->curr = NULL;
+    arena->blockSize = ARENA_ROUND(blockSize);
+}
+
+static ArenaBlock *Arena_NewBlock(size_t size) {
+    // the block header and its data share one allocation
+    ArenaBlock *block = omaligned_alloc(ARENA_ALIGN, ARENA_ROUND(sizeof(ArenaBlock)) + size);
+    block->next = NULL;
+    block->data = (unsigned char *)block + ARENA_ROUND(sizeof(ArenaBlock));
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void *Arena_Alloc(Arena *arena, size_t size) {
+    size = ARENA_ROUND(size);
+
+    if (!arena->curr) {
+        arena->head = Arena_NewBlock(size > arena->blockSize ? size : arena->blockSize);
+        arena->curr = arena->head;
+    }
+
+    ArenaBlock *block = arena->curr;
+    while (block->size - block->used < size) {
+        // move on to the next block kept from before the last reset
+        if (block->next && (block->next->size >= size)) {
+            block = block->next;
+            block->used = 0;
+        }
+        // out of blocks (or the next one is too small), so add one after the
+        // current block
+        else {
+            ArenaBlock *newBlock = Arena_NewBlock(size > arena->blockSize ? size : arena->blockSize);
+            newBlock->next = block->next;
+            block->next = newBlock;
+            block = newBlock;
+        }
+    }
+    arena->curr = block;
+
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void Arena_Reset(Arena *arena) {
+    // later blocks get their used counts cleared when Arena_Alloc reaches them
+    arena->curr = arena->head;
+    if (arena->head) {
+        arena->head->used = 0;
+    }
+}
+
+void Arena_Free(Arena *arena) {
+    ArenaBlock *block = arena->head;
+    while (block) {
+        ArenaBlock *next = block->next;
+        omaligned_free(block);
+        block = next;
+    }
+    arena->head = NULL;
+    arena->curr = NULL;
+}
@@ -50,3 +50,44 @@ void omaligned_free(void *mem);
  * @returns pointer to allocated memory
  */
 void *omrealloc(void *ptr, size_t new_size);
+
+typedef struct ArenaBlock ArenaBlock;
+
+// Region allocator: hands out memory from a chain of large blocks, and frees
+// everything at once. Blocks are kept around after a reset so reloading the
+// same data doesn't touch the system allocator again.
+typedef struct {
+    ArenaBlock *head;
+    ArenaBlock *curr;
+    size_t blockSize;
+} Arena;
+
+/**
+ * @brief Sets up an empty arena. No memory is allocated until the first
+ * Arena_Alloc call.
+ * @param arena the arena to initialize
+ * @param blockSize the size of each block the arena allocates
+ */
+void Arena_Init(Arena *arena, size_t blockSize);
+
+/**
+ * @brief Allocates memory from an arena, aborting on out of memory. The
+ * memory is suitably aligned for any type.
+ * @param arena the arena to allocate from
+ * @param size allocation size
+ * @returns pointer to allocated memory
+ */
+void *Arena_Alloc(Arena *arena, size_t size);
+
+/**
+ * @brief Frees everything allocated from an arena at once. The arena keeps its
+ * blocks so they can be reused.
+ * @param arena the arena to reset
+ */
+void Arena_Reset(Arena *arena);
+
+/**
+ * @brief Returns all of an arena's blocks to the system allocator
+ * @param arena the arena to free
+ */
+void Arena_Free(Arena *arena);
@@ -71,9 +71,19 @@ void Buffer_Add(Buffer *buf, Uint8 data) {
 }
 
 void Buffer_AddData(Buffer *buf, Uint8 *data, int len) {
-    for (int i = 0; i < len; i++) {
-        Buffer_Add(buf, data[i]);
+    // like Buffer_Add, always leave room for at least one more byte
+    if ((buf->dataSize + len) >= buf->allocSize) {
+        while ((buf->dataSize + len) >= buf->allocSize) {
+            buf->allocSize *= 2;
+        }
+        buf->data = omrealloc(buf->data, buf->allocSize);
     }
+    memcpy(buf->data + buf->dataSize, data, len);
+    buf->dataSize += len;
+}
+
+void Buffer_ReadData(Buffer *buf, int index, void *out, int len) {
+    memcpy(out, buf->data + index, len);
 }
 
 void Buffer_AddUint16(Buffer *buf, Uint16 data) {
@@ -71,6 +71,15 @@ void Buffer_Add(Buffer *buf, Uint8 data);
  */
 void Buffer_AddData(Buffer *buf, Uint8 *data, int len);
 
+/**
+ * @brief Reads a series of bytes out of a buffer
+ * @param buf buffer to read out of
+ * @param index where to read from in the buffer
+ * @param out where to copy the bytes to
+ * @param len how many bytes to read
+ */
+void Buffer_ReadData(Buffer *buf, int index, void *out, int len);
+
 /**
  * @brief Adds a Uint16 to the end of a buffer (big-endian format)
  * @param buf buffer to add to
@@ -0,0 +1,376 @@
+/* check.c: Consistency checks and benchmarks
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "buffer.h"
+#include "camera.h"
+#include "check.h"
+#include "constants.h"
+#include "demo.h"
+#include "game.h"
+#include "graphics.h"
+#include "hashlog.h"
+#include "joy.h"
+#include "lucia.h"
+#include "map.h"
+#include "nanotime.h"
+#include "object.h"
+#include "platform.h"
+#include "rng.h"
+#include "sound.h"
+#include "sprite.h"
+#include "state.h"
+#include "system.h"
+#include "task.h"
+#include "util.h"
+#include "weapon.h"
+
+// how long to play each demo for (same as the title screen)
+#define CHECK_DEMO_FRAMES (1200)
+static Uint64 checkHashes[2][CHECK_DEMO_FRAMES];
+static Uint64 *stateHashes = NULL;
+static int numStateHashes;
+static char **checkFilenames;
+static int numCheckFilenames;
+static char *checkFilename;
+static CheckMode checkMode;
+// when set, the game state gets saved and loaded back every frame
+static Uint8 stateRoundTrip = 0;
+static Buffer *roundTripBuffers[2];
+static Uint64 roundTripNs;
+static Uint64 roundTripMaxNs;
+static int roundTrips;
+// framebuffer hashes for the frame check
+static Uint64 frameHashes[CHECK_DEMO_FRAMES];
+static int numFrameHashes;
+
+void Check_Init(char **filenames, int count, CheckMode mode) {
+    checkFilenames = filenames;
+    numCheckFilenames = count;
+    checkMode = mode;
+}
+
+static void Check_StateRoundTrip(void) {
+    if (!roundTripBuffers[0]) {
+        roundTripBuffers[0] = Buffer_Init(16 * 1024);
+        roundTripBuffers[1] = Buffer_Init(16 * 1024);
+    }
+
+    Uint64 start = nanotime_now();
+    int saved = State_Save(roundTripBuffers[0], 0);
+    int loaded = State_Load(roundTripBuffers[0]);
+    Uint64 time = nanotime_now() - start;
+    assert(saved && loaded);
+    roundTripNs += time;
+    roundTripMaxNs = MAX(roundTripMaxNs, time);
+    roundTrips++;
+
+    // anything State_Save captures that State_Load doesn't fully restore will
+    // show up as a difference here
+    State_Save(roundTripBuffers[1], 0);
+    if ((roundTripBuffers[0]->dataSize != roundTripBuffers[1]->dataSize) ||
+        memcmp(roundTripBuffers[0]->data, roundTripBuffers[1]->data, roundTripBuffers[0]->dataSize))
+    {
+        printf("State changed after loading it (frame %d)\n", numStateHashes);
+    }
+}
+
+// runs at the start of every frame while a demo is being checked
+static void Check_FrameBoundary(void) {
+    if (stateRoundTrip) {
+        Check_StateRoundTrip();
+    }
+    if (numStateHashes < CHECK_DEMO_FRAMES) {
+        stateHashes[numStateHashes++] = Game_HashState();
+    }
+}
+
+static void Check_DemoTask(void) {
+    Game_PlayDemo(checkFilename);
+}
+
+static void Check_RecordFrameHash(void) {
+    if (numFrameHashes < CHECK_DEMO_FRAMES) {
+        frameHashes[numFrameHashes++] = Graphics_HashFramebuffer(UTIL_HASH64_INIT);
+    }
+}
+
+// plays the demo in checkFilename, hashing every frame that gets drawn
+static void Check_HashDemoFrames(void) {
+    numFrameHashes = 0;
+    System_SetFrameFunc(Check_RecordFrameHash);
+    Task_Child(Check_DemoTask, CHECK_DEMO_FRAMES, 0);
+    System_SetFrameFunc(NULL);
+    Demo_Uninit();
+    Sound_Reset();
+}
+
+static void Check_Frames(void) {
+    int failed = 0;
+    static Uint64 goldenHashes[CHECK_DEMO_FRAMES];
+    char goldenFilename[256];
+    // every frame has to get drawn for the hashes to line up
+    Platform_SuspendFrameskip(1);
+    System_SetSpeed(1);
+
+    for (int i = 0; i < numCheckFilenames; i++) {
+        checkFilename = checkFilenames[i];
+        // golden file is the demo filename with the extension swapped out
+        const char *ext = strrchr(checkFilename, '.');
+        int baseLen = ext ? (int)(ext - checkFilename) : (int)strlen(checkFilename);
+        snprintf(goldenFilename, sizeof(goldenFilename), "%.*s.frames", baseLen, checkFilename);
+
+        if (checkMode == CHECK_RECORD_FRAMES) {
+            // the last implementation is the most portable one (plain C, or
+            // Neon on ARM64, where it's always available)
+            Graphics_UseBGTileFunc(Graphics_NumBGTileFuncs() - 1);
+            Check_HashDemoFrames();
+            if (!numFrameHashes) {
+                printf("%s: couldn't play demo\n", checkFilename);
+                failed = 1;
+            }
+            else if (!HashLog_Save(goldenFilename, frameHashes, numFrameHashes)) {
+                failed = 1;
+            }
+            else {
+                printf("%s: recorded %s (%d frames)\n", checkFilename, goldenFilename, numFrameHashes);
+            }
+            continue;
+        }
+
+        int goldenCount = HashLog_Load(goldenFilename, goldenHashes, CHECK_DEMO_FRAMES);
+        if (goldenCount < 0) {
+            printf("%s: FAILED, no golden file %s (write it with -framerecord)\n", checkFilename, goldenFilename);
+            failed = 1;
+            continue;
+        }
+
+        // play the demo once with each tile drawing implementation
+        for (int func = 0; func < Graphics_NumBGTileFuncs(); func++) {
+            const char *funcName = Graphics_UseBGTileFunc(func);
+            Check_HashDemoFrames();
+
+            int frames = MIN(goldenCount, numFrameHashes);
+            int mismatch = -1;
+            for (int frame = 0; frame < frames; frame++) {
+                if (goldenHashes[frame] != frameHashes[frame]) {
+                    mismatch = frame;
+                    break;
+                }
+            }
+            if (!numFrameHashes) {
+                printf("%s [%s]: couldn't play demo\n", checkFilename, funcName);
+                failed = 1;
+            }
+            else if (mismatch >= 0) {
+                printf("%s [%s]: FAILED, frame %d differs\n", checkFilename, funcName, mismatch);
+                failed = 1;
+            }
+            else if (goldenCount != numFrameHashes) {
+                printf("%s [%s]: FAILED, demo lengths differ (%d vs %d frames)\n",
+                       checkFilename, funcName, goldenCount, numFrameHashes);
+                failed = 1;
+            }
+            else {
+                printf("%s [%s]: OK (%d frames)\n", checkFilename, funcName, frames);
+            }
+        }
+    }
+
+    Graphics_UseBGTileFunc(0);
+    Platform_SuspendFrameskip(0);
+    printf("Frame %s %s\n", (checkMode == CHECK_RECORD_FRAMES) ? "record" : "check", failed ? "failed" : "passed");
+    Platform_Quit();
+}
+
+void Check_Task(void) {
+    int failed = 0;
+
+    if ((checkMode == CHECK_FRAMES) || (checkMode == CHECK_RECORD_FRAMES)) {
+        Check_Frames();
+        return;
+    }
+
+    Game_SetFrameBoundaryFunc(Check_FrameBoundary);
+    for (int i = 0; i < numCheckFilenames; i++) {
+        int hashCounts[2];
+        checkFilename = checkFilenames[i];
+        // play the demo once normally and once the way we're checking
+        for (int pass = 0; pass < 2; pass++) {
+            if (checkMode == CHECK_DISPATCH) {
+                Object_SetGroupedDispatch(pass);
+            }
+            else {
+                stateRoundTrip = pass;
+            }
+            stateHashes = checkHashes[pass];
+            numStateHashes = 0;
+            Task_Child(Check_DemoTask, CHECK_DEMO_FRAMES, 0);
+            Demo_Uninit();
+            Sound_Reset();
+            hashCounts[pass] = numStateHashes;
+        }
+
+        int frames = MIN(hashCounts[0], hashCounts[1]);
+        int mismatch = -1;
+        for (int frame = 0; frame < frames; frame++) {
+            if (checkHashes[0][frame] != checkHashes[1][frame]) {
+                mismatch = frame;
+                break;
+            }
+        }
+        if (!frames) {
+            printf("%s: couldn't play demo\n", checkFilename);
+            failed = 1;
+        }
+        else if (mismatch >= 0) {
+            printf("%s: FAILED, state differs at frame %d\n", checkFilename, mismatch);
+            failed = 1;
+        }
+        else if (hashCounts[0] != hashCounts[1]) {
+            printf("%s: FAILED, demo lengths differ (%d vs %d frames)\n", checkFilename, hashCounts[0], hashCounts[1]);
+            failed = 1;
+        }
+        else {
+            printf("%s: OK (%d frames)\n", checkFilename, frames);
+        }
+    }
+    Game_SetFrameBoundaryFunc(NULL);
+
+    Object_SetGroupedDispatch(0);
+    stateRoundTrip = 0;
+    if ((checkMode == CHECK_STATE) && roundTrips) {
+        printf("State save+load: %d bytes, avg %.2f us, max %.2f us\n",
+               roundTripBuffers[0]->dataSize,
+               (double)roundTripNs / roundTrips / 1000.0,
+               (double)roundTripMaxNs / 1000.0);
+    }
+    printf("%s check %s\n", (checkMode == CHECK_DISPATCH) ? "Dispatch" : "State",
+           failed ? "failed" : "passed");
+    Platform_Quit();
+}
+
+// --- stress test ---
+static Uint8 stressStage;
+static int stressRoom;
+static int stressFrames;
+static Uint8 stressTypes[NUM_OBJECTS];
+static int numStressTypes;
+
+void Check_StressInit(Uint8 stage, int room, int frames, const Uint8 *types, int count) {
+    stressStage = stage;
+    stressRoom = room;
+    stressFrames = frames;
+    numStressTypes = MIN(count, ARRAY_LEN(stressTypes));
+    memcpy(stressTypes, types, numStressTypes);
+}
+
+// fills every free enemy slot with the stress test object types. Searching
+// past MAX_OBJECTS grows the object list and skips the reserved item and Wing
+// slots.
+static int Check_StressFill(int cursor) {
+    Object *lucia = Object_Get(OBJECT_HANDLE_LUCIA);
+    Object *o;
+    while ((o = Object_FindNext(ENEMY_SLOT, OBJECT_POOL_LIMIT))) {
+        memset(o, 0, sizeof(Object));
+        // spread the objects out over the screen
+        o->x.f.h = cameraX.f.h + (cursor % SCREEN_WIDTH_METATILES);
+        o->x.f.l = 0x80;
+        o->y.f.h = cameraY.f.h + ((cursor / SCREEN_WIDTH_METATILES) % (SCREEN_HEIGHT_METATILES - 4));
+        o->y.f.l = 0x80;
+        Object_InitCollision(o);
+        if (Object_CollisionOutOfBounds(o)) {
+            o->x = lucia->x;
+            o->y = lucia->y;
+            Object_InitCollision(o);
+        }
+        o->type = stressTypes[cursor % numStressTypes];
+        Object_FaceLucia(o);
+        cursor++;
+    }
+    return cursor;
+}
+
+void Check_StressTask(void) {
+    stressRoom = Game_StartInRoom(stressStage, stressRoom);
+    if (stressRoom < 0) {
+        printf("Room must be between 0-%d.\n", mapData->numRooms - 1);
+        Platform_Quit();
+    }
+    health = maxHealth = 5000;
+    magic = maxMagic = 5000;
+    // start from the same state every time
+    rngVal = 0;
+    gameFrames = 0;
+
+    int cursor = 0;
+    Uint64 totalNs = 0;
+    Uint64 maxNs = 0;
+    Uint64 totalSprites = 0;
+    int maxSprites = 0;
+    Uint64 totalObjects = 0;
+    int startOverflows, startOverlayOverflows;
+    Sprite_GetOverflows(&startOverflows, &startOverlayOverflows);
+
+    for (int frame = 0; frame < stressFrames; frame++) {
+        Task_Yield();
+        // ignore the controller so every run gets the same input
+        joy = 0;
+        joyEdge = 0;
+        joyDir = 0;
+        health = 5000;
+
+        Uint64 start = nanotime_now();
+        gameFrames++;
+        Sprite_ClearOverlayList();
+        Game_DrawHud();
+        Sprite_ClearList();
+        RNG_Get();
+        cursor = Check_StressFill(cursor);
+        Weapon_Process();
+        Object_ListRun();
+        Map_Draw();
+        Sprite_DisplayOverlay();
+        Sprite_Display();
+        Uint64 time = nanotime_now() - start;
+
+        int objectCount = 0;
+        for (int i = 0; i < objectCapacity; i++) {
+            if (objects[i].type) { objectCount++; }
+        }
+        totalNs += time;
+        maxNs = MAX(maxNs, time);
+        totalSprites += Sprite_Count();
+        maxSprites = MAX(maxSprites, Sprite_Count());
+        totalObjects += objectCount;
+    }
+
+    int overflows, overlayOverflows;
+    Sprite_GetOverflows(&overflows, &overlayOverflows);
+    int frames = MAX(stressFrames, 1);
+    printf("Stress test: stage %d, room %d, %d frames, %d object types\n", stage + 1, stressRoom, stressFrames, numStressTypes);
+    printf("Frame time:      avg %.3f ms, max %.3f ms\n", (double)totalNs / frames / 1000000.0, (double)maxNs / 1000000.0);
+    printf("Objects:         avg %.1f (%d slots at the end)\n", (double)totalObjects / frames, objectCapacity);
+    printf("Sprites:         avg %.1f, max %d\n", (double)totalSprites / frames, maxSprites);
+    printf("Dropped sprites: %d (overlay: %d)\n", overflows - startOverflows, overlayOverflows - startOverlayOverflows);
+    Platform_Quit();
+}
@@ -0,0 +1,72 @@
+/* check.h: Consistency checks and benchmarks
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "constants.h"
+
+typedef enum {
+    // check that grouped object dispatch matches slot order dispatch
+    CHECK_DISPATCH,
+    // check that saving and loading the game state every frame doesn't change
+    // anything
+    CHECK_STATE,
+    // check that every Graphics_DrawBGTile implementation draws the same
+    // frames as the demo's golden file (demo name with .frames instead of .dem)
+    CHECK_FRAMES,
+    // write the golden files for CHECK_FRAMES, using the most portable
+    // Graphics_DrawBGTile implementation
+    CHECK_RECORD_FRAMES,
+} CheckMode;
+
+/**
+ * @brief Gets ready to check that an alternate way of running the game gives
+ * the same results as the normal way.
+ * @param filenames demo files to check
+ * @param count number of demo files
+ * @param mode what to check (see CheckMode)
+ */
+void Check_Init(char **filenames, int count, CheckMode mode);
+
+/**
+ * @brief Plays each demo twice, once normally and once the way being checked,
+ * and compares the game state every frame. For CHECK_FRAMES, plays each
+ * demo once per BG tile drawing implementation and compares the framebuffer
+ * against the golden file instead (a missing golden file is a failure), and
+ * CHECK_RECORD_FRAMES writes the golden files. Prints the results and quits.
+ * Should only be run (as a task) after Check_Init.
+ */
+void Check_Task(void);
+
+/**
+ * @brief Gets ready to run the object stress test.
+ * @param stage stage number (0-15)
+ * @param room room number, or -1 to use the stage's starting room
+ * @param frames how many frames to run for
+ * @param types object types to fill the object list with
+ * @param count number of object types
+ */
+void Check_StressInit(Uint8 stage, int room, int frames, const Uint8 *types, int count);
+
+/**
+ * @brief Fills every free object slot with the stress test objects each frame
+ * (growing the object list up to OBJECT_POOL_LIMIT, with no controller input)
+ * and prints frame time, object and sprite stats at the end, then quits.
+ * Should only be run (as a task) after Check_StressInit.
+ */
+void Check_StressTask(void);
@@ -17,6 +17,14 @@
  * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include "constants.h"
+
+#if defined(OM_AMD64)
+#include <emmintrin.h>
+#endif
+#if defined(OM_ARM64)
+#include <arm_neon.h>
+#endif
 #include <stdio.h>
 
 #include "collision.h"
@@ -47,6 +55,45 @@ static Sint16 yHitboxMasks[] = {
     0xFFF0, 0xFFE0, 0xFFE0,
 };
 
+// Returns a bitmask of the weapons whose hitbox overlaps the given point (bit
+// n = weapon n), whether or not they're spawned. All the weapons get checked
+// at once: the 8 x and y positions fit in one 128-bit vector. Coordinates are
+// screen/room pixels, far from the 16-bit limits, so doing the subtraction in
+// 16 bits gives the same result as the int math in the scalar version.
+static int Collision_WeaponHits(Sint16 xCenter, Sint16 yCenter, int size) {
+#if defined(OM_AMD64)
+    __m128i zero = _mm_setzero_si128();
+    __m128i xs = _mm_loadu_si128((const __m128i *)weaponCoords.x);
+    __m128i ys = _mm_loadu_si128((const __m128i *)weaponCoords.y);
+    __m128i xDiff = _mm_sub_epi16(_mm_set1_epi16(xCenter), xs);
+    __m128i yDiff = _mm_sub_epi16(_mm_set1_epi16(yCenter), ys);
+    __m128i xHit = _mm_cmpeq_epi16(_mm_and_si128(xDiff, _mm_set1_epi16(xHitboxMasks[size])), zero);
+    __m128i yHit = _mm_cmpeq_epi16(_mm_and_si128(yDiff, _mm_set1_epi16(yHitboxMasks[size])), zero);
+    // pack the 16-bit lanes to bytes so movemask gives one bit per weapon
+    return _mm_movemask_epi8(_mm_packs_epi16(_mm_and_si128(xHit, yHit), zero));
+#elif defined(OM_ARM64)
+    static const uint16_t laneBits[8] = { 1, 2, 4, 8, 16, 32, 64, 128 };
+    int16x8_t xs = vld1q_s16(weaponCoords.x);
+    int16x8_t ys = vld1q_s16(weaponCoords.y);
+    int16x8_t xDiff = vsubq_s16(vdupq_n_s16(xCenter), xs);
+    int16x8_t yDiff = vsubq_s16(vdupq_n_s16(yCenter), ys);
+    uint16x8_t xHit = vceqzq_s16(vandq_s16(xDiff, vdupq_n_s16(xHitboxMasks[size])));
+    uint16x8_t yHit = vceqzq_s16(vandq_s16(yDiff, vdupq_n_s16(yHitboxMasks[size])));
+    return vaddvq_u16(vandq_u16(vandq_u16(xHit, yHit), vld1q_u16(laneBits)));
+#else
+    int hits = 0;
+    for (int i = 0; i < MAX_WEAPONS; i++) {
+        if (((yCenter - weaponCoords.y[i]) & yHitboxMasks[size]) ||
+            ((xCenter - weaponCoords.x[i]) & xHitboxMasks[size]))
+        {
+            continue;
+        }
+        hits |= (1 << i);
+    }
+    return hits;
+#endif
+}
+
 int Collision_Handle(Object *o, Sprite *s, int size, Uint8 attackPower) {
     Sint16 xCenter = s->x + xHitboxOffsets[size];
     Sint16 yCenter = s->y + yHitboxOffsets[size];
@@ -69,25 +116,20 @@ int Collision_Handle(Object *o, Sprite *s, int size, Uint8 attackPower) {
          Sprite_Draw(&hitSpr, o);
     }
 
-    for (int i = (MAX_WEAPONS - 1); i >= 0; i--) {
-        if (!weaponCoords[i].spawned || 
-            ((gameType == GAME_TYPE_ORIGINAL) && weaponCoords[i].collided))
-        {
-            continue;
-        }
-
-        // if y coordinate is out of range
-        if ((yCenter - weaponCoords[i].y) & yHitboxMasks[size]) {
-            continue;
-        }
-
-        // if x coordinate is out of range
-        if ((xCenter - weaponCoords[i].x) & xHitboxMasks[size]) {
-            continue;
+    // in the original game, each weapon can only hit one enemy per frame
+    int candidates = weaponCoords.spawned;
+    if (gameType == GAME_TYPE_ORIGINAL) {
+        candidates &= ~weaponCoords.collided;
+    }
+    if (candidates) {
+        int hits = Collision_WeaponHits(xCenter, yCenter, size) & candidates;
+        if (hits) {
+            // the highest numbered weapon gets the hit
+            int i = MAX_WEAPONS - 1;
+            while (!(hits & (1 << i))) { i--; }
+            weaponCoords.collided |= (1 << i);
+            goto enemyDamaged;
         }
-
-        weaponCoords[i].collided = 1;
-        goto enemyDamaged;
     }
 
     // if we're still here, there's no hits so check if the object collided with Lucia
@@ -16,6 +16,7 @@
  * You should have received a copy of the GNU General Public License
  * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
  */
+#include <stdlib.h>
 #include <string.h>
 
 #include "buffer.h"
@@ -28,6 +29,9 @@
 #include "util.h"
 #include "weapon.h"
 
+// rngVal, gameFrames, gameType, stage, health, magic, bootsLevel, weaponLevels
+#define DEMO_HEADER_SIZE (4 + 2 + 2 + 1 + NUM_WEAPONS)
+
 static Buffer *demoBuff = NULL;
 static Buffer *recordFilename = NULL;
 static int recording = 0;
@@ -87,13 +91,32 @@ int Demo_Playback(char *filename, DemoData *out) {
     out->magic = Util_LoadSint16(demoBuff->data + cursor); cursor += 2;
     out->bootsLevel = demoBuff->data[cursor++];
     memcpy(out->weaponLevels, demoBuff->data + cursor, sizeof(out->weaponLevels));
-    cursor += sizeof(weaponLevels);
+    cursor = DEMO_HEADER_SIZE;
     frameCount = demoBuff->data[cursor];
     // get first button press ready
     Task_Yield();
     return 1;
 }
 
+int Demo_Length(char *filename) {
+    FILE *fp = File_OpenResource(filename, "rb");
+    if (!fp) { return 0; }
+    int size;
+    Uint8 *data = File_Load(fp, &size);
+    fclose(fp);
+
+    // the header is the DemoData fields, then every input is stored as a
+    // repeat count (frames - 1) followed by 4 bytes of joypad data
+    int cursor = DEMO_HEADER_SIZE;
+    int frames = 0;
+    while ((cursor + 5) <= size) {
+        frames += data[cursor] + 1;
+        cursor += 5;
+    }
+    free(data);
+    return frames;
+}
+
 void Demo_Uninit(void) {
     recording = 0;
     playing = 0;
@@ -132,13 +155,15 @@ void Demo_RecordInput(Uint32 input) {
 }
 
 Uint32 Demo_GetInput(void) {
-    if (!playing || (cursor > demoBuff->dataSize)) { return 0; }
+    if (!playing || ((cursor + 5) > demoBuff->dataSize)) { return 0; }
     
     Uint32 joy = Util_LoadUint32(demoBuff->data + cursor + 1);
     frameCount--;
     if (frameCount == 255) {
         cursor += 5;
-        frameCount = demoBuff->data[cursor];
+        if (cursor < demoBuff->dataSize) {
+            frameCount = demoBuff->data[cursor];
+        }
     }
     return joy;
 }
@@ -46,6 +46,13 @@ void Demo_Record(char *filename, DemoData *data);
  */
 int Demo_Playback(char *filename, DemoData *out);
 
+/**
+ * @brief Gets how many frames of input a demo file has, without playing it.
+ * @param filename demo file to check
+ * @returns the number of frames, or 0 if the demo couldn't be opened
+ */
+int Demo_Length(char *filename);
+
 /**
  * @brief Ends demo recording/playback
  */
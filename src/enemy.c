@@ -25,8 +25,6 @@
 #include "object.h"
 #include "rng.h"
 
-#define ENEMY_SLOT (9)
-
 static int Enemy_InitLocation(Object *o) {
     o->type = OBJ_NONE;
     o->x.v = cameraX.v + 0x80;
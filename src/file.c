@@ -175,4 +175,17 @@ Uint8 *File_Load(FILE *fp, int *size) {
     fread(data, 1, fileSize, fp);
     if (size) { *size = fileSize; }
     return data;
-}
\ No newline at end of file
+}
+
+Uint64 File_GetModTime(FILE *fp) {
+#ifdef OM_UNIX
+    struct stat st;
+    if (fstat(fileno(fp), &st) == 0) {
+        return (Uint64)st.st_mtime;
+    }
+    return 0;
+#else
+    (void)fp;
+    return 0;
+#endif
+}
@@ -83,3 +83,11 @@ FILE *File_OpenResource(const char *filename, const char *mode);
  * @returns A pointer to the loaded data (malloced, user code must free it)
  */
 Uint8 *File_Load(FILE *fp, int *size);
+
+/**
+ * @brief Gets the last modification time of an open file.
+ * @param fp the file to check
+ * @returns the modification time in seconds, or 0 if it isn't available on
+ * this platform
+ */
+Uint64 File_GetModTime(FILE *fp);
@@ -27,8 +27,10 @@
 #include "ending.h"
 #include "enemy.h"
 #include "game.h"
+#include "hashlog.h"
 #include "highscore.h"
 #include "hud.h"
+#include "input.h"
 #include "item.h"
 #include "joy.h"
 #include "lucia.h"
@@ -39,15 +41,18 @@
 #include "palette.h"
 #include "pausemenu.h"
 #include "platform.h"
+#include "rewind.h"
 #include "rng.h"
 #include "rom.h"
 #include "save.h"
 #include "screen.h"
 #include "sound.h"
 #include "sprite.h"
+#include "state.h"
 #include "system.h"
 #include "task.h"
 #include "title.h"
+#include "util.h"
 #include "weapon.h"
 
 #define SOFT_RESET (JOY_A | JOY_B | JOY_START | JOY_SELECT)
@@ -67,6 +72,21 @@ Sint8 keywordDisplay;
 Uint8 fountainUsed;
 // arcade stuff
 Uint32 score;
+// the last room number Lucia was in this stage
+static Uint16 lastRoom;
+// set while the game task is waiting at the frame boundary in Game_RunStage,
+// the only place game states can be saved and loaded
+static Uint8 atFrameBoundary = 0;
+// number of frames to simulate ahead of the real game before drawing (0 = off)
+static int runAheadFrames = 0;
+static Buffer *runAheadState = NULL;
+// button presses belong to the real frame, so the speculative frames don't
+// see them (they're put back by Game_EndRunAhead)
+static Uint32 runAheadJoyEdge;
+static Uint32 runAheadJoyEdgeRaw;
+// incremented each time the map data is reloaded, so states from a previous
+// game can't be loaded
+static Uint32 sessionNum = 0;
 
 Uint8 spritePalettes[16] = {
     0x00, 0x12, 0x16, 0x36,
@@ -82,12 +102,15 @@ static void Game_InitCommon(void);
 static void Game_InitDemo(DemoData *data);
 static void Game_Run(void);
 static int Game_RunStage(void);
-static void Game_DrawHud(void);
 static void Game_HandleWeaponSwitch(void);
 static void Game_HandlePause(void);
 static void Game_SetRoom(Uint8 roomNum);
 static void Game_HandlePaletteShifting(void);
 static void Game_HandleRoomChange(void);
+static void Game_RecordStateHash(void);
+static void Game_RunFrame(void);
+static int Game_RunAhead(void);
+static void Game_EndRunAhead(void);
 
 typedef enum {
     STAGE_EXIT_NEXTSTAGE,
@@ -139,15 +162,8 @@ static void Game_InitNewGame(void) {
 }
 
 static void Game_InitCommon(void) {
-    if (mapData) {
-        Map_FreeData(mapData);
-    }
-    if (gameType == GAME_TYPE_ARCADE) {
-        mapData = Rom_GetMapDataArcade();
-    }
-    else {
-        mapData = Rom_GetMapData();
-    }
+    sessionNum++;
+    Map_LoadData(gameType);
     score = 0;
     lives = 3;
     paused = 0;
@@ -180,13 +196,14 @@ static void Game_InitRoomVars(Object *lucia) {
 
     // if we're in an item room and the item hasn't been collected, spawn it
     if ((info.type == SPAWN_TYPE_ITEM) && (!Item_Collected(lucia))) {
-        objects[9].type = OBJ_ITEM;
-        objects[9].hp = info.enemy - ITEM_FLAG;
-        objects[9].x.f.h = (lucia->x.f.h & 0x70) | 7;
-        objects[9].y.f.h = (lucia->y.f.h & 0x70) | itemSpawnYOffsets[lucia->y.f.h >> 5];
-        objects[9].x.f.l = 0x80;
-        objects[9].y.f.l = 0x80;
-        objects[9].ySpeed = 0;
+        Object *item = Object_Claim(OBJECT_HANDLE_ITEM);
+        item->type = OBJ_ITEM;
+        item->hp = info.enemy - ITEM_FLAG;
+        item->x.f.h = (lucia->x.f.h & 0x70) | 7;
+        item->y.f.h = (lucia->y.f.h & 0x70) | itemSpawnYOffsets[lucia->y.f.h >> 5];
+        item->x.f.l = 0x80;
+        item->y.f.l = 0x80;
+        item->ySpeed = 0;
     }
     
     // if we're in the boss room and the boss hasn't been defeated, set up the
@@ -209,14 +226,15 @@ static void Game_InitRoomVars(Object *lucia) {
 
     // spawn the wing of madoola if lucia hasn't collected it yet
     if (stage == 15) {
+        Object *wing = Object_Claim(OBJECT_HANDLE_WING);
         if (!hasWing) {
-            objects[MAX_OBJECTS - 1].type = OBJ_WING_OF_MADOOLA;
+            wing->type = OBJ_WING_OF_MADOOLA;
         }
         // NOTE: This wasn't in the original game. This fixes a bug where
         // collecting the Wing of Madoola and then going into a door would
         // cause Daltos not to spawn, softlocking the game.
         else {
-            objects[MAX_OBJECTS - 1].type = OBJ_DALTOS_INIT;
+            wing->type = OBJ_DALTOS_INIT;
         }
     }
 
@@ -230,9 +248,10 @@ static Sint8 fountainYTbl[] = {0x0A, 0x1A, 0x1A, 0x1A, 0x26, 0x26, 0x26};
 static Uint8 fountainPalette[] = {0x26, 0x03, 0x31, 0x21};
 static void Game_SpawnFountain(SpawnInfo *info) {
     Uint8 offset = (info->enemy & 0x7) - 1;
-    objects[9].x.f.h = fountainXTbl[offset];
-    objects[9].y.f.h = fountainYTbl[offset];
-    objects[9].type = OBJ_FOUNTAIN;
+    Object *fountain = Object_Claim(OBJECT_HANDLE_ITEM);
+    fountain->x.f.h = fountainXTbl[offset];
+    fountain->y.f.h = fountainYTbl[offset];
+    fountain->type = OBJ_FOUNTAIN;
     Sprite_SetPalette(2, fountainPalette);
 }
 
@@ -322,6 +341,94 @@ void Game_PlayDemo(char *filename) {
     Demo_Uninit();
 }
 
+// run at the start of every frame of a stage (see Game_SetFrameBoundaryFunc)
+static void (*frameBoundaryFunc)(void) = NULL;
+
+Uint64 Game_HashState(void) {
+    Uint64 hash = UTIL_HASH64_INIT;
+    hash = Util_Hash64(hash, objects, objectCapacity * sizeof(Object));
+    hash = Util_Hash64(hash, &weaponCoords, sizeof(weaponCoords));
+    hash = Util_Hash64(hash, &rngVal, sizeof(rngVal));
+    hash = Util_Hash64(hash, &gameFrames, sizeof(gameFrames));
+    hash = Util_Hash64(hash, &cameraX, sizeof(cameraX));
+    hash = Util_Hash64(hash, &cameraY, sizeof(cameraY));
+    hash = Util_Hash64(hash, &luciaXPos, sizeof(luciaXPos));
+    hash = Util_Hash64(hash, &luciaYPos, sizeof(luciaYPos));
+    hash = Util_Hash64(hash, &attackTimer, sizeof(attackTimer));
+    hash = Util_Hash64(hash, &luciaHurtPoints, sizeof(luciaHurtPoints));
+    hash = Util_Hash64(hash, &usingWing, sizeof(usingWing));
+    hash = Util_Hash64(hash, &health, sizeof(health));
+    hash = Util_Hash64(hash, &magic, sizeof(magic));
+    hash = Util_Hash64(hash, &score, sizeof(score));
+    return Sprite_Hash(hash);
+}
+
+static void Game_RecordStateHash(void) {
+    if (HashLog_Enabled()) {
+        HashLog_Write(Game_HashState());
+    }
+}
+
+void Game_SetFrameBoundaryFunc(void (*func)(void)) {
+    frameBoundaryFunc = func;
+}
+
+// the rewind hotkeys are bindable inputs too, so one only rewinds when it isn't
+// also being used as a joypad button
+static int Game_RewindHeld(int input) {
+    return inputState[input] && !Joy_InputMapped(input);
+}
+
+// runs while the game task is at the frame boundary, where states can be saved
+// and loaded. returns 1 if the game was rewound, meaning this frame's game
+// logic should be skipped.
+static int Game_FrameBoundary(void) {
+    if (frameBoundaryFunc) {
+        frameBoundaryFunc();
+    }
+
+    // demos are inputs only, so rewinding would make them go out of sync
+    if (!Rewind_Enabled() || !State_Available() || Demo_Playing() || Demo_Recording()) {
+        return 0;
+    }
+    // hold backspace or the left trigger to rewind (unless the player has
+    // mapped them to a joypad button)
+    if (Game_RewindHeld(INPUT_KEY_BACKSPACE) || Game_RewindHeld(INPUT_GAMEPAD_L_TRIGGER)) {
+        if (Rewind_Pop()) { return 1; }
+    }
+    else {
+        Rewind_Push();
+    }
+    return 0;
+}
+
+int Game_StartInRoom(Uint8 _stage, int room) {
+    Game_InitNewGame();
+    Game_InitCommon();
+    stage = _stage;
+    if (room < 0) {
+        room = mapData->stages[stage].roomNum;
+    }
+    if (room >= mapData->numRooms) { return -1; }
+
+    Object_ListInit();
+    Sound_Reset();
+    Object *lucia = Object_Get(OBJECT_HANDLE_LUCIA);
+    memset(lucia, 0, sizeof(Object));
+    if (room == mapData->stages[stage].roomNum) {
+        lucia->x = mapData->stages[stage].xPos;
+        lucia->y = mapData->stages[stage].yPos;
+    }
+    // put lucia in the middle of the first screen of other rooms
+    else {
+        lucia->x.f.h = SCREEN_WIDTH_METATILES / 2;
+        lucia->y.f.h = SCREEN_HEIGHT_METATILES / 2;
+    }
+    Game_SetRoom((Uint8)room);
+    Game_InitRoomVars(lucia);
+    return room;
+}
+
 static void Game_InitDemo(DemoData *data) {
     Game_InitNewGame();
     Game_InitCommon();
@@ -336,8 +443,9 @@ static void Game_InitDemo(DemoData *data) {
 }
 
 static int Game_RunStage(void) {
-    // the last room number Lucia was in this stage
-    Uint16 lastRoom = 0xffff;
+    lastRoom = 0xffff;
+    // don't let the player rewind back into the previous stage
+    Rewind_Reset();
 
     Object_ListInit();
     // in arcade mode, health refills up to 1000 between stages
@@ -386,7 +494,12 @@ initRoom:
     while (1) {
         gameFrames++;
         Game_HandlePaletteShifting();
+        atFrameBoundary = 1;
         Task_Yield();
+        int rewound = Game_FrameBoundary();
+        atFrameBoundary = 0;
+        // a state load may have moved the object list
+        lucia = Object_Get(OBJECT_HANDLE_LUCIA);
         Sprite_ClearOverlayList();
         // when recording a demo, pressing start ends the demo recording
         if (Demo_Recording() && (joyEdge & JOY_START)) {
@@ -394,14 +507,14 @@ initRoom:
         }
         Game_HandlePause();
         Game_DrawHud();
-        if (!paused) {
-            Sprite_ClearList();
-            RNG_Get(); // update RNG once per frame
-            Weapon_Process();
-            Object_ListRun();
-            Enemy_Spawn();
-            Game_HandleRoomChange();
+        // when rewinding, the loaded state already has the sprites that were
+        // shown on that frame
+        if (!paused && !rewound) {
+            Game_RunFrame();
+            Game_RecordStateHash();
         }
+        // no need to run ahead if the frame isn't getting drawn
+        int ranAhead = !rewound && renderFrame && Game_RunAhead();
         Map_Draw();
         // if we're paused or an odd number of frames, draw the hud over the game sprites
         if (paused || (gameFrames & 1)) {
@@ -412,6 +525,11 @@ initRoom:
             Sprite_DisplayOverlay();
             Sprite_Display();
         }
+        if (ranAhead) {
+            Game_EndRunAhead();
+        }
+        // the object list may have moved
+        lucia = Object_Get(OBJECT_HANDLE_LUCIA);
 
         // --- handle keyword screen ---
         if (keywordDisplay > 0) {
@@ -457,6 +575,110 @@ initRoom:
     }
 }
 
+// runs one frame of game logic
+static void Game_RunFrame(void) {
+    Sprite_ClearList();
+    RNG_Get(); // update RNG once per frame
+    Weapon_Process();
+    Object_ListRun();
+    Enemy_Spawn();
+    Game_HandleRoomChange();
+}
+
+// Simulates runAheadFrames frames past the current one with the current input,
+// so the frame that gets drawn shows the result of the input sooner. The real
+// state gets restored by Game_EndRunAhead after drawing. Returns 1 if the game
+// ran ahead.
+static int Game_RunAhead(void) {
+    if (!runAheadFrames || paused) { return 0; }
+    // room changes and the keyword screen happen outside of the frame logic,
+    // so the game can't run ahead past them
+    if ((roomChangeTimer == 1) || (keywordDisplay > 0)) { return 0; }
+
+    if (!runAheadState) {
+        runAheadState = Buffer_Init(16 * 1024);
+    }
+    // the end of the frame logic is a safe place to save states too, nothing
+    // but the lucia pointer is held across it
+    atFrameBoundary = 1;
+    // the speculative frames don't touch the sound engine (it's headless),
+    // and in callback audio mode the audio thread keeps running it, so
+    // loading the sound state back would replay music ticks
+    State_Save(runAheadState, STATE_NO_SOUND);
+    // only the real frames should make sounds
+    Sound_SetHeadless(1);
+    // the real frame already handled this frame's presses, so only keep the
+    // held buttons. otherwise a single press would repeat in every frame
+    runAheadJoyEdge = joyEdge;
+    runAheadJoyEdgeRaw = joyEdgeRaw;
+    joyEdge = 0;
+    joyEdgeRaw = 0;
+    for (int i = 0; i < runAheadFrames; i++) {
+        gameFrames++;
+        Game_HandlePaletteShifting();
+        Game_RunFrame();
+        if ((roomChangeTimer == 1) || (keywordDisplay > 0)) { break; }
+    }
+    Sound_SetHeadless(0);
+    return 1;
+}
+
+static void Game_EndRunAhead(void) {
+    State_Load(runAheadState);
+    joyEdge = runAheadJoyEdge;
+    joyEdgeRaw = runAheadJoyEdgeRaw;
+    atFrameBoundary = 0;
+}
+
+void Game_SetRunAhead(int frames) {
+    runAheadFrames = frames;
+}
+
+int Game_AtFrameBoundary(void) {
+    return atFrameBoundary && !paused;
+}
+
+Uint32 Game_SessionNum(void) {
+    return sessionNum;
+}
+
+typedef struct {
+    void *ptr;
+    int size;
+} GameStateVar;
+
+#define GAME_STATE_VAR(var) {&(var), sizeof(var)}
+
+static const GameStateVar gameStateVars[] = {
+    GAME_STATE_VAR(paused),
+    GAME_STATE_VAR(stage),
+    GAME_STATE_VAR(highestReachedStage),
+    GAME_STATE_VAR(orbCollected),
+    GAME_STATE_VAR(roomChangeTimer),
+    GAME_STATE_VAR(bossActive),
+    GAME_STATE_VAR(numBossObjs),
+    GAME_STATE_VAR(bossDefeated),
+    GAME_STATE_VAR(gameFrames),
+    GAME_STATE_VAR(keywordDisplay),
+    GAME_STATE_VAR(fountainUsed),
+    GAME_STATE_VAR(score),
+    GAME_STATE_VAR(lastRoom),
+};
+
+void Game_SaveSnapshot(Buffer *buf) {
+    for (int i = 0; i < ARRAY_LEN(gameStateVars); i++) {
+        Buffer_AddData(buf, gameStateVars[i].ptr, gameStateVars[i].size);
+    }
+}
+
+int Game_LoadSnapshot(Buffer *buf, int index) {
+    for (int i = 0; i < ARRAY_LEN(gameStateVars); i++) {
+        Buffer_ReadData(buf, index, gameStateVars[i].ptr, gameStateVars[i].size);
+        index += gameStateVars[i].size;
+    }
+    return index;
+}
+
 void Game_PlayRoomSong(void) {
     Sound_Reset();
     Uint8 song = mapData->rooms[currRoom].song;
@@ -516,7 +738,7 @@ void Game_AddScore(Uint32 points) {
     }
 }
 
-static void Game_DrawHud(void) {
+void Game_DrawHud(void) {
     switch (gameType) {
     case GAME_TYPE_ORIGINAL:
         HUD_DisplayOriginal(health, magic);
@@ -18,6 +18,7 @@
  */
 
 #pragma once
+#include "buffer.h"
 #include "constants.h"
 
 #define GAME_TYPE_ORIGINAL 0
@@ -80,6 +81,69 @@ void Game_RecordDemoTask(void);
  */
 void Game_PlayDemo(char *filename);
 
+/**
+ * @brief Sets a function to run at the start of every frame of a stage, while
+ * the game is at the frame boundary (so it can save and load states). Used by
+ * the demo checks.
+ * @param func the function to run, or NULL for none
+ */
+void Game_SetFrameBoundaryFunc(void (*func)(void));
+
+/**
+ * @returns a hash of the game state that affects gameplay (objects, Lucia,
+ * RNG, camera, score and the sprite list)
+ */
+Uint64 Game_HashState(void);
+
+/**
+ * @brief Sets up a new game that starts in the given room of a stage, for
+ * tools that need the game in a specific spot (like the stress test). Lucia
+ * starts at the stage's starting position in its starting room, and in the
+ * middle of the first screen of any other room.
+ * @param _stage stage number (0-15)
+ * @param room room number, or -1 to use the stage's starting room
+ * @returns the room number, or -1 if the room doesn't exist
+ */
+int Game_StartInRoom(Uint8 _stage, int room);
+
+/**
+ * @brief Draws the HUD (health, magic, score...) to the overlay sprites.
+ */
+void Game_DrawHud(void);
+
+/**
+ * @brief Sets how many frames to run ahead. Each frame, the game simulates
+ * this many extra frames with the current input, draws the last one, then
+ * goes back to the real state, which hides the game's built-in input lag.
+ * @param frames number of frames to run ahead (0 turns it off)
+ */
+void Game_SetRunAhead(int frames);
+
+/**
+ * @returns 1 if the game task is waiting at the frame boundary in the stage
+ * loop (and the game isn't paused), 0 otherwise
+ */
+int Game_AtFrameBoundary(void);
+
+/**
+ * @returns a number that changes every time a new game (or demo) starts
+ */
+Uint32 Game_SessionNum(void);
+
+/**
+ * @brief Adds the game's global state to a state snapshot
+ * @param buf buffer to add to
+ */
+void Game_SaveSnapshot(Buffer *buf);
+
+/**
+ * @brief Restores the game's global state from a state snapshot
+ * @param buf buffer to read from
+ * @param index where the game state starts in the buffer
+ * @returns the index right after the game state
+ */
+int Game_LoadSnapshot(Buffer *buf, int index);
+
 /**
  * @brief Plays the song associated with the current room.
 */
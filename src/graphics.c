@@ -36,6 +36,7 @@
 #include "palette.h"
 #include "platform.h"
 #include "rom.h"
+#include "util.h"
 
 #define TILE_PACKED_SIZE (16)
 #define TILE_SIZE (TILE_WIDTH * TILE_HEIGHT)
@@ -46,8 +47,16 @@ static Uint8 *chrData;
 static Uint8 *drawPalette;
 // where we're drawing to
 static Uint8 *screen;
+Uint8 renderFrame = 1;
 
 void (*Graphics_DrawBGTile)(int x, int y, int tilenum, int palnum);
+// every Graphics_DrawBGTile implementation this computer supports, fastest first
+typedef struct {
+    const char *name;
+    void (*func)(int x, int y, int tilenum, int palnum);
+} BGTileFunc;
+static BGTileFunc bgTileFuncs[4];
+static int numBGTileFuncs = 0;
 #if defined(OM_AMD64)
 static void Graphics_DrawBGTileAVX2(int x, int y, int tilenum, int palnum);
 static void Graphics_DrawBGTileSSSE3(int x, int y, int tilenum, int palnum);
@@ -61,6 +70,12 @@ static void Graphics_DrawBGTileNeon(int x, int y, int tilenum, int palnum);
 static void Graphics_DrawBGTileFallback(int x, int y, int tilenum, int palnum);
 #endif
 
+static void Graphics_AddBGTileFunc(const char *name, void (*func)(int x, int y, int tilenum, int palnum)) {
+    bgTileFuncs[numBGTileFuncs].name = name;
+    bgTileFuncs[numBGTileFuncs].func = func;
+    numBGTileFuncs++;
+}
+
 int Graphics_Init(void) {
     // convert planar 2bpp to chunky 8bpp
     chrData = omaligned_alloc(32, chrRomSize * 4);
@@ -88,47 +103,61 @@ int Graphics_Init(void) {
         }
     }
 
+    numBGTileFuncs = 0;
 #if defined(OM_AMD64)
 #if defined(__GNUC__)
     if (__builtin_cpu_supports("avx2")) {
-        Graphics_DrawBGTile = Graphics_DrawBGTileAVX2;
+        Graphics_AddBGTileFunc("AVX2", Graphics_DrawBGTileAVX2);
     }
-    else if (__builtin_cpu_supports("ssse3")) {
-        Graphics_DrawBGTile = Graphics_DrawBGTileSSSE3;
-    }
-    else {
-        Graphics_DrawBGTile = Graphics_DrawBGTileFallback;
+    if (__builtin_cpu_supports("ssse3")) {
+        Graphics_AddBGTileFunc("SSSE3", Graphics_DrawBGTileSSSE3);
     }
 #elif defined(_MSC_VER)
     if (__check_isa_support(__IA_SUPPORT_VECTOR256, 0)) {
-        Graphics_DrawBGTile = Graphics_DrawBGTileAVX2;
+        Graphics_AddBGTileFunc("AVX2", Graphics_DrawBGTileAVX2);
     }
-    else {
-        // SSSE3 support is at CPUID page 1, ECX bit 9
-        Uint32 cpuInfo[4];
-        __cpuid(cpuInfo, 1);
-        if (cpuInfo[2] & (1 << 9)) {
-            Graphics_DrawBGTile = Graphics_DrawBGTileSSSE3;
-        }
-        else {
-            Graphics_DrawBGTile = Graphics_DrawBGTileFallback;
-        }
+    // SSSE3 support is at CPUID page 1, ECX bit 9
+    Uint32 cpuInfo[4];
+    __cpuid(cpuInfo, 1);
+    if (cpuInfo[2] & (1 << 9)) {
+        Graphics_AddBGTileFunc("SSSE3", Graphics_DrawBGTileSSSE3);
     }
-#else
-    Graphics_DrawBGTile = Graphics_DrawBGTileFallback;
+#endif
 #endif // defined(OM_AMD64)
-#elif defined(OM_ARM64)
-    Graphics_DrawBGTile = Graphics_DrawBGTileNeon;
+#if defined(OM_ARM64)
+    Graphics_AddBGTileFunc("Neon", Graphics_DrawBGTileNeon);
 #else
-    Graphics_DrawBGTile = Graphics_DrawBGTileFallback;
+    Graphics_AddBGTileFunc("Fallback", Graphics_DrawBGTileFallback);
 #endif
+    Graphics_DrawBGTile = bgTileFuncs[0].func;
     return 1;
 }
 
+int Graphics_NumBGTileFuncs(void) {
+    return numBGTileFuncs;
+}
+
+const char *Graphics_UseBGTileFunc(int num) {
+    if ((num < 0) || (num >= numBGTileFuncs)) { return NULL; }
+    Graphics_DrawBGTile = bgTileFuncs[num].func;
+    return bgTileFuncs[num].name;
+}
+
+Uint64 Graphics_HashFramebuffer(Uint64 hash) {
+    Uint8 *framebuffer = Platform_GetFramebuffer();
+    // skip past the buffer around the framebuffer
+    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+        hash = Util_Hash64(hash, framebuffer + ((y + TILE_HEIGHT) * FRAMEBUFFER_WIDTH) + TILE_WIDTH, SCREEN_WIDTH);
+    }
+    return hash;
+}
+
 void Graphics_StartFrame(void) {
     screen = Platform_GetFramebuffer();
     drawPalette = Palette_Run();
-    memset(screen, colorPalette[0], FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+    if (renderFrame) {
+        memset(screen, colorPalette[0], FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT);
+    }
 }
 
 void Graphics_DrawTile(int x, int y, int tilenum, int palnum, int mirror) {
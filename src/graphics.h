@@ -28,6 +28,11 @@
 
 // --- Functions that you need to implement for the game to work ---
 
+// When 0, Graphics_StartFrame, BG_Display, Map_Draw, and the sprite display
+// functions don't draw anything. Used to skip drawing frames that won't be
+// presented.
+extern Uint8 renderFrame;
+
 /**
  * @brief Initializes graphics and framebuffer
  * @returns 1 on success, 0 on failure
@@ -59,3 +64,25 @@ void Graphics_DrawTile(int x, int y, int tilenum, int palnum, int mirror);
  * @param palnum palette number
  */
 extern void (*Graphics_DrawBGTile)(int x, int y, int tilenum, int palnum);
+
+/**
+ * @returns the number of Graphics_DrawBGTile implementations this computer
+ * supports
+ */
+int Graphics_NumBGTileFuncs(void);
+
+/**
+ * @brief Switches Graphics_DrawBGTile to a different implementation. Number 0
+ * is the fastest one, which Graphics_Init picks.
+ * @param num implementation number (0 to Graphics_NumBGTileFuncs() - 1)
+ * @returns the implementation's name ("AVX2", "SSSE3", etc), or NULL if num
+ * is invalid
+ */
+const char *Graphics_UseBGTileFunc(int num);
+
+/**
+ * @brief Adds the visible part of the framebuffer to a hash.
+ * @param hash UTIL_HASH64_INIT, or the result of a previous hash function
+ * @returns the updated hash
+ */
+Uint64 Graphics_HashFramebuffer(Uint64 hash);
@@ -0,0 +1,118 @@
+/* hashlog.c: Per-frame game state hash log
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "constants.h"
+#include "hashlog.h"
+
+static FILE *logFile = NULL;
+
+int HashLog_Open(const char *filename) {
+    logFile = fopen(filename, "w");
+    if (!logFile) {
+        fprintf(stderr, "Couldn't open %s for writing.\n", filename);
+        return 0;
+    }
+    return 1;
+}
+
+int HashLog_Enabled(void) {
+    return logFile != NULL;
+}
+
+void HashLog_SetFile(FILE *fp) {
+    logFile = fp;
+}
+
+void HashLog_Write(Uint64 hash) {
+    if (logFile) {
+        fprintf(logFile, "%016" PRIx64 "\n", hash);
+    }
+}
+
+// returns 1 if a hash was read, 0 at the end of the file
+static int HashLog_Read(FILE *fp, Uint64 *hash) {
+    return fscanf(fp, "%" SCNx64, hash) == 1;
+}
+
+int HashLog_Load(const char *filename, Uint64 *hashes, int max) {
+    FILE *fp = fopen(filename, "r");
+    if (!fp) { return -1; }
+    int count = 0;
+    while ((count < max) && HashLog_Read(fp, &hashes[count])) {
+        count++;
+    }
+    fclose(fp);
+    return count;
+}
+
+int HashLog_Save(const char *filename, const Uint64 *hashes, int count) {
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Couldn't open %s for writing.\n", filename);
+        return 0;
+    }
+    for (int i = 0; i < count; i++) {
+        fprintf(fp, "%016" PRIx64 "\n", hashes[i]);
+    }
+    fclose(fp);
+    return 1;
+}
+
+int HashLog_Compare(const char *filename1, const char *filename2) {
+    FILE *fp1 = fopen(filename1, "r");
+    if (!fp1) {
+        fprintf(stderr, "Couldn't open %s.\n", filename1);
+        return 0;
+    }
+    FILE *fp2 = fopen(filename2, "r");
+    if (!fp2) {
+        fprintf(stderr, "Couldn't open %s.\n", filename2);
+        fclose(fp1);
+        return 0;
+    }
+
+    int match = 0;
+    int frame = 0;
+    while (1) {
+        Uint64 hash1, hash2;
+        int read1 = HashLog_Read(fp1, &hash1);
+        int read2 = HashLog_Read(fp2, &hash2);
+        if (!read1 && !read2) {
+            printf("Logs match (%d frames)\n", frame);
+            match = 1;
+            break;
+        }
+        if (!read1 || !read2) {
+            printf("Logs match for %d frames, then %s ends\n", frame, read1 ? filename2 : filename1);
+            break;
+        }
+        if (hash1 != hash2) {
+            printf("Logs differ at frame %d (%016" PRIx64 " vs %016" PRIx64 ")\n", frame, hash1, hash2);
+            break;
+        }
+        frame++;
+    }
+
+    fclose(fp1);
+    fclose(fp2);
+    return match;
+}
@@ -0,0 +1,74 @@
+/* hashlog.h: Per-frame game state hash log
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stdio.h>
+#include "constants.h"
+
+/**
+ * @brief Starts writing a hash of the game state after every frame of
+ * gameplay to a file, one hash per line.
+ * @param filename the file to write to
+ * @returns 1 on success, 0 if the file couldn't be opened
+ */
+int HashLog_Open(const char *filename);
+
+/**
+ * @returns 1 if a hash log is being written, 0 otherwise
+ */
+int HashLog_Enabled(void);
+
+/**
+ * @brief Starts writing game state hashes to an already open file.
+ * @param fp the file to write to (gets written to by other code too, so the
+ * caller is responsible for closing it)
+ */
+void HashLog_SetFile(FILE *fp);
+
+/**
+ * @brief Adds a frame's hash to the log. Does nothing if no log is open.
+ * @param hash the hash of the game state
+ */
+void HashLog_Write(Uint64 hash);
+
+/**
+ * @brief Reads the hashes from a hash log.
+ * @param filename the log to read
+ * @param hashes where to put the hashes
+ * @param max maximum number of hashes to read
+ * @returns the number of hashes read, or -1 if the file couldn't be opened
+ */
+int HashLog_Load(const char *filename, Uint64 *hashes, int max);
+
+/**
+ * @brief Writes a list of hashes to a file in the hash log format.
+ * @param filename the file to write
+ * @param hashes the hashes to write
+ * @param count number of hashes
+ * @returns 1 on success, 0 if the file couldn't be opened
+ */
+int HashLog_Save(const char *filename, const Uint64 *hashes, int count);
+
+/**
+ * @brief Compares two hash logs and prints the first frame where they differ.
+ * @param filename1 the first log
+ * @param filename2 the second log
+ * @returns 1 if the logs match, 0 if they don't or couldn't be read
+ */
+int HashLog_Compare(const char *filename1, const char *filename2);
@@ -156,14 +156,28 @@ Uint8 inputState[NUM_INPUT_BUTTONS];
 
 static void (*onPress)(int);
 
+// --- latency tracking ---
+// when each button was pressed (0 = already consumed)
+static Uint64 pressTimes[NUM_INPUT_BUTTONS];
+// earliest press consumed this frame that hasn't been presented yet
+static Uint64 pendingTimes[NUM_INPUT_DEVICES];
+// latency histogram buckets are this many nanoseconds wide
+#define LATENCY_BUCKET_NS (100000)
+// 0-100 ms, anything past that goes in the last bucket
+#define LATENCY_BUCKETS (1000)
+static Uint32 latencyBuckets[NUM_INPUT_DEVICES][LATENCY_BUCKETS];
+static Uint32 latencyCounts[NUM_INPUT_DEVICES];
+static Uint64 latencyMinNs[NUM_INPUT_DEVICES];
 
-void Input_SetState(int button, Uint8 state) {
+
+void Input_SetState(int button, Uint8 state, Uint64 timestamp) {
     if ((button < 0) || (button >= NUM_INPUT_BUTTONS)) {
         printf("Invalid button: %d\n", button);
         return;
     }
-    if (state && !inputState[button] && onPress) {
-        onPress(button);
+    if (state && !inputState[button]) {
+        if (onPress) { onPress(button); }
+        pressTimes[button] = timestamp;
     }
     inputState[button] = state;
 }
@@ -178,3 +192,55 @@ const char *Input_ButtonName(int button) {
 void Input_SetOnPressFunc(void (*func)(int)) {
     onPress = func;
 }
+
+void Input_ConsumePress(int button) {
+    if ((button < 0) || (button >= NUM_INPUT_BUTTONS)) { return; }
+    if (!pressTimes[button]) { return; }
+
+    int device = (button >= INPUT_GAMEPAD_MIN) ? INPUT_DEVICE_GAMEPAD : INPUT_DEVICE_KEYBOARD;
+    if (!pendingTimes[device] || (pressTimes[button] < pendingTimes[device])) {
+        pendingTimes[device] = pressTimes[button];
+    }
+    pressTimes[button] = 0;
+}
+
+void Input_FramePresented(Uint64 timestamp) {
+    for (int device = 0; device < NUM_INPUT_DEVICES; device++) {
+        if (!pendingTimes[device]) { continue; }
+        Uint64 latency = (timestamp > pendingTimes[device]) ? (timestamp - pendingTimes[device]) : 0;
+        pendingTimes[device] = 0;
+
+        Uint64 bucket = MIN(latency / LATENCY_BUCKET_NS, LATENCY_BUCKETS - 1);
+        latencyBuckets[device][bucket]++;
+        if (!latencyCounts[device] || (latency < latencyMinNs[device])) {
+            latencyMinNs[device] = latency;
+        }
+        latencyCounts[device]++;
+    }
+}
+
+// returns the latency in ms that the given fraction of presses were at or under
+static double Input_LatencyPercentile(int device, double fraction) {
+    Uint32 target = (Uint32)(latencyCounts[device] * fraction);
+    Uint32 count = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        count += latencyBuckets[device][i];
+        if (count > target) {
+            return (double)((i + 1) * LATENCY_BUCKET_NS) / 1000000.0;
+        }
+    }
+    return (double)(LATENCY_BUCKETS * LATENCY_BUCKET_NS) / 1000000.0;
+}
+
+void Input_PrintLatency(void) {
+    static const char *deviceNames[] = {"Keyboard", "Gamepad"};
+    for (int device = 0; device < NUM_INPUT_DEVICES; device++) {
+        if (!latencyCounts[device]) { continue; }
+        printf("%s press to present latency: min %.1f ms, median %.1f ms, p99 %.1f ms (%u presses)\n",
+               deviceNames[device],
+               (double)latencyMinNs[device] / 1000000.0,
+               Input_LatencyPercentile(device, 0.5),
+               Input_LatencyPercentile(device, 0.99),
+               latencyCounts[device]);
+    }
+}
@@ -152,14 +152,22 @@ typedef enum {
     NUM_INPUT_BUTTONS,
 } INPUT_BUTTON;
 
+typedef enum {
+    INPUT_DEVICE_KEYBOARD,
+    INPUT_DEVICE_GAMEPAD,
+    NUM_INPUT_DEVICES,
+} INPUT_DEVICE;
+
 extern Uint8 inputState[NUM_INPUT_BUTTONS];
 
 /**
  * @brief Used by the platform code to set the state of a given button
  * @param button see INPUT_BUTTON enum
  * @param state Nonzero for pressed, zero for released
+ * @param timestamp When the button changed state in nanoseconds, on the same
+ * clock as the timestamp passed to Input_FramePresented (must be nonzero)
  */
-void Input_SetState(int button, Uint8 state);
+void Input_SetState(int button, Uint8 state, Uint64 timestamp);
 
 /**
  * @param button The button to get the name of (see INPUT_BUTTON enum)
@@ -171,4 +179,26 @@ const char *Input_ButtonName(int button);
  * @brief Sets up a function to be run when a button is pressed
  * @param func press callback
  */
-void Input_SetOnPressFunc(void (*func)(int));
\ No newline at end of file
+void Input_SetOnPressFunc(void (*func)(int));
+
+/**
+ * @brief Marks a button press as used by the game, so the next frame that's
+ * presented counts towards the press's latency. Presses that were already
+ * consumed are ignored.
+ * @param button see INPUT_BUTTON enum
+ */
+void Input_ConsumePress(int button);
+
+/**
+ * @brief Used by the platform code when a frame is presented. Records the
+ * latency of any presses consumed since the last frame was presented.
+ * @param timestamp When the frame was presented in nanoseconds
+ */
+void Input_FramePresented(Uint64 timestamp);
+
+/**
+ * @brief Prints the minimum, median, and 99th percentile latency between
+ * button presses and presenting the first frame that used them, separately
+ * for the keyboard and gamepad.
+ */
+void Input_PrintLatency(void);
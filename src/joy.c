@@ -107,6 +107,13 @@ const char *Joy_StrGamepad(Uint32 joyButton) {
     return Input_ButtonName(gamepadMappings[index]);
 }
 
+int Joy_InputMapped(int input) {
+    for (int i = 0; i < ARRAY_LEN(keyMappings); i++) {
+        if ((keyMappings[i] == input) || (gamepadMappings[i] == input)) { return 1; }
+    }
+    return 0;
+}
+
 void Joy_SaveMappings(void) {
     Uint8 joyBuffer[(ARRAY_LEN(keyMappings) + ARRAY_LEN(gamepadMappings)) * 2];
     for (int i = 0; i < ARRAY_LEN(keyMappings); i++) {
@@ -159,5 +166,12 @@ void Joy_Update(void) {
 
     joyEdge = (~joyLast) & joy;
     joyEdgeRaw = (~joyLastRaw) & joyRaw;
+    // for latency tracking
+    for (int i = 0; i < ARRAY_LEN(keyMappings); i++) {
+        if (joyEdgeRaw & (1 << i)) {
+            Input_ConsumePress(keyMappings[i]);
+            Input_ConsumePress(gamepadMappings[i]);
+        }
+    }
     joyDir = direction_table[joy & 0xf];
 }
@@ -73,6 +73,14 @@ void Joy_MapGamepad(int gamepadButton, Uint32 joyButton);
  */
 const char *Joy_StrGamepad(Uint32 joyButton);
 
+/**
+ * @brief Checks if an input is mapped to any joypad button, so hotkeys can
+ * stay out of the way of the player's bindings
+ * @param input see INPUT_BUTTON enum
+ * @returns 1 if the input is mapped to a joypad button, 0 if it isn't
+ */
+int Joy_InputMapped(int input);
+
 /**
  * @brief Writes the current joypad button mappings to disk
  */
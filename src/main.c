@@ -25,15 +25,22 @@
 #endif
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include "check.h"
 #include "demo.h"
 #include "game.h"
+#include "hashlog.h"
+#include "object.h"
+#include "platform.h"
+#include "rewind.h"
 #include "sound.h"
 #include "soundtest.h"
 #include "system.h"
 #include "task.h"
 #include "title.h"
+#include "verify.h"
 #include "weapon.h"
 
 static int checkFlag(char *str, char *match) {
@@ -65,8 +72,98 @@ int main(int argc, char **argv) {
     }
 #endif
 
+    // compare two hash logs (doesn't need the game to be running)
+    if ((argc == 4) && checkFlag(argv[1], "hashcompare")) {
+        return HashLog_Compare(argv[2], argv[3]) ? 0 : 1;
+    }
+
+    // verify every demo in a directory: -verifydemos <dir> <jobs>, or write
+    // their expected hashes: -recorddemos <dir> <jobs>
+    // (forks worker processes, which carry on below and play their demos)
+    int verifyDemos = (argc == 4) && (checkFlag(argv[1], "verifydemos") || checkFlag(argv[1], "recorddemos"));
+    if (verifyDemos) {
+        int jobs = atoi(argv[3]);
+        if (jobs < 1) {
+            fprintf(stderr, "Job count must be at least 1.\n");
+            return -1;
+        }
+        int result = Verify_Run(argv[2], jobs, checkFlag(argv[1], "recorddemos"));
+        if (result != VERIFY_WORKER) { return result; }
+    }
+
     if (!System_Init()) { return -1; }
 
+    // use grouped object dispatch (can be combined with any of the below)
+    if ((argc >= 2) && checkFlag(argv[1], "g")) {
+        Object_SetGroupedDispatch(1);
+        argc--;
+        argv++;
+    }
+
+    // keep up to this many megabytes of states for rewinding
+    if ((argc >= 3) && checkFlag(argv[1], "rewind")) {
+        int megabytes = atoi(argv[2]);
+        if ((megabytes < 1) || (megabytes > 4095)) {
+            fprintf(stderr, "Rewind buffer size must be between 1-4095 MB.\n");
+            return -1;
+        }
+        Rewind_Init((size_t)megabytes * 1024 * 1024);
+        argc -= 2;
+        argv += 2;
+    }
+
+    // simulate this many frames ahead to cut down on input lag
+    if ((argc >= 3) && checkFlag(argv[1], "runahead")) {
+        int frames = atoi(argv[2]);
+        if ((frames < 0) || (frames > 4)) {
+            fprintf(stderr, "Run-ahead frames must be between 0-4.\n");
+            return -1;
+        }
+        Game_SetRunAhead(frames);
+        argc -= 2;
+        argv += 2;
+    }
+
+    // start frames just in time with vsync (saved as a setting)
+    if ((argc >= 3) && checkFlag(argv[1], "jit")) {
+        Platform_SetJIT(atoi(argv[2]) ? 1 : 0);
+        argc -= 2;
+        argv += 2;
+    }
+
+    // print input latency stats on exit
+    if ((argc >= 2) && checkFlag(argv[1], "latency")) {
+        System_EnableLatency();
+        argc--;
+        argv++;
+    }
+
+    // run this many frames per displayed frame ("max" = as many as possible)
+    if ((argc >= 3) && checkFlag(argv[1], "speed")) {
+        int frames = (strcmp(argv[2], "max") == 0) ? 0 : atoi(argv[2]);
+        if ((frames < 0) || ((frames == 0) && strcmp(argv[2], "max"))) {
+            fprintf(stderr, "Speed must be a number of frames or \"max\".\n");
+            return -1;
+        }
+        System_SetSpeed(frames);
+        argc -= 2;
+        argv += 2;
+    }
+
+    // skip drawing frames when running behind (saved as a setting)
+    if ((argc >= 3) && checkFlag(argv[1], "frameskip")) {
+        Platform_SetFrameskip(atoi(argv[2]) ? 1 : 0);
+        argc -= 2;
+        argv += 2;
+    }
+
+    // write a hash of the game state after every frame to a file
+    if ((argc >= 3) && checkFlag(argv[1], "hashlog")) {
+        if (!HashLog_Open(argv[2])) { return -1; }
+        argc -= 2;
+        argv += 2;
+    }
+
     // play mml file
     if ((argc == 3) && checkFlag(argv[1], "p")) {
         SoundTest_RunStandaloneInit(argv[2]);
@@ -77,8 +174,58 @@ int main(int argc, char **argv) {
         // load game music & sfx
         if (!Sound_LoadGameSounds()) { return -1; }
 
+        // worker process for -verifydemos/-recorddemos
+        if (verifyDemos) {
+            Task_Init(Verify_WorkerTask);
+        }
+        // check that grouped object dispatch matches slot order dispatch
+        else if ((argc >= 3) && checkFlag(argv[1], "dispatchcheck")) {
+            Check_Init(argv + 2, argc - 2, CHECK_DISPATCH);
+            Task_Init(Check_Task);
+        }
+        // check that every BG tile drawing implementation matches the golden frames
+        else if ((argc >= 3) && checkFlag(argv[1], "framecheck")) {
+            Check_Init(argv + 2, argc - 2, CHECK_FRAMES);
+            Task_Init(Check_Task);
+        }
+        // write the golden frames that -framecheck compares against
+        else if ((argc >= 3) && checkFlag(argv[1], "framerecord")) {
+            Check_Init(argv + 2, argc - 2, CHECK_RECORD_FRAMES);
+            Task_Init(Check_Task);
+        }
+        // check that saving and loading the game state doesn't change anything
+        else if ((argc >= 3) && checkFlag(argv[1], "statecheck")) {
+            Check_Init(argv + 2, argc - 2, CHECK_STATE);
+            Task_Init(Check_Task);
+        }
+        // object stress test: -stress <stage> <room (-1 = stage's starting room)> <frames> <object types...>
+        else if ((argc >= 6) && checkFlag(argv[1], "stress")) {
+            int stage = atoi(argv[2]);
+            if ((stage < 1) || (stage > 16)) {
+                fprintf(stderr, "Stage must be between 1-16.\n");
+                return -1;
+            }
+            int room = atoi(argv[3]);
+            int frames = atoi(argv[4]);
+            if (frames < 1) {
+                fprintf(stderr, "Frame count must be at least 1.\n");
+                return -1;
+            }
+            Uint8 types[NUM_OBJECTS];
+            int count = 0;
+            for (int i = 5; (i < argc) && (count < NUM_OBJECTS); i++) {
+                int type = Object_TypeFromName(argv[i]);
+                if (type <= OBJ_NONE) {
+                    fprintf(stderr, "Unknown object type %s.\n", argv[i]);
+                    return -1;
+                }
+                types[count++] = (Uint8)type;
+            }
+            Check_StressInit((Uint8)(stage - 1), room, frames, types, count);
+            Task_Init(Check_StressTask);
+        }
         // record demo
-        if ((argc == (8 + NUM_WEAPONS)) && checkFlag(argv[1], "r")) {
+        else if ((argc == (8 + NUM_WEAPONS)) && checkFlag(argv[1], "r")) {
             int param = 2;
             char *filename = argv[param++];
             Uint8 type = (Uint8)atoi(argv[param++]);
@@ -22,64 +22,181 @@
 
 #include "alloc.h"
 #include "constants.h"
+#include "game.h"
 #include "graphics.h"
 #include "map.h"
 #include "object.h"
 #include "palette.h"
+#include "rom.h"
 
 MapData *mapData;
+// the decompressed rooms take up about 1.3MB, so this fits everything in one
+// block
+#define MAP_ARENA_BLOCK_SIZE (2 * 1024 * 1024)
+
+// The original and plus game types use the same map data, arcade patches it
+typedef enum {
+    MAP_LAYOUT_CONSOLE = 0,
+    MAP_LAYOUT_ARCADE,
+    MAP_NUM_LAYOUTS,
+} MAP_LAYOUT;
+
+// Map data for each layout. It gets built from the ROM the first time that
+// layout is played, and kept in its own arena after that.
+typedef struct {
+    Arena arena;
+    MapData *data;
+    // untouched copy of each tileset's metatiles (the level end door
+    // animation edits them in place)
+    Metatile *metatiles[3];
+} MapCache;
+static MapCache mapCaches[MAP_NUM_LAYOUTS];
 Uint16 *mapMetatiles;
 Uint8 currRoom = 0xff;
 Uint8 roomWidthMetatiles, roomHeightMetatiles;
+Uint8 (*mapPlanes)[MAP_PLANE_BYTES];
 static Uint16 scrollX;
 static Uint16 scrollY;
 
-void Map_FreeData(MapData *data) {
-    for (int i = 0; i < data->numTilesets; i++) {
-        free(data->tilesets[i].metatiles);
-    }
-    free(data->tilesets);
-    free(data->chunks);
-    free(data->screens);
-    free(data->warpDoors);
-    for (int i = 0; i < data->numRooms; i++) {
-        free(data->rooms[i].screenNums);
-    }
-    free(data->rooms);
-    free(data);
+static void Map_SetBit(Uint8 *plane, Uint16 offset, int val) {
+    Uint8 bit = 1 << (offset & 7);
+    if (val) { plane[offset >> 3] |= bit; }
+    else { plane[offset >> 3] &= ~bit; }
 }
 
+// reads a metatile's solid/ladder bit, treating everything past the room as
+// solid like the bounds checks in the original game
+static int Map_ReadGround(Uint16 *metatiles, Uint16 offset, Uint16 mapBound, Uint16 limit) {
+    if (offset >= mapBound) { return 1; }
+    return metatiles[offset] < limit;
+}
 
-void Map_Init(Uint8 roomNum) {
-    if (roomNum == currRoom) { return; }
+static void Map_DecompressRoom(MapData *data, Room *room) {
+    Uint8 widthMetatiles = room->width * SCREEN_WIDTH_METATILES;
 
-    currRoom = roomNum;
-    Uint8 roomWidthScreens = mapData->rooms[currRoom].width;
-    Uint8 roomHeightScreens = mapData->rooms[currRoom].height;
-    roomWidthMetatiles = roomWidthScreens * SCREEN_WIDTH_METATILES;
-    roomHeightMetatiles = roomHeightScreens * SCREEN_HEIGHT_METATILES;
-    if (mapMetatiles) { free(mapMetatiles); }
-    mapMetatiles = ommalloc(roomWidthMetatiles * roomHeightMetatiles * sizeof(Uint16));
-
-    // decompress the room's metatiles
-    for (int screenY = 0; screenY < roomHeightScreens; screenY++) {
-        for (int screenX = 0; screenX < roomWidthScreens; screenX++) {
-            int screenNum = mapData->rooms[roomNum].screenNums[screenY * roomWidthScreens + screenX];
+    for (int screenY = 0; screenY < room->height; screenY++) {
+        for (int screenX = 0; screenX < room->width; screenX++) {
+            int screenNum = room->screenNums[screenY * room->width + screenX];
             for (int chunkY = 0; chunkY < 4; chunkY++) {
                 for (int chunkX = 0; chunkX < 4; chunkX++) {
-                    int chunkNum = mapData->screens[screenNum][chunkY * 4 + chunkX];
+                    int chunkNum = data->screens[screenNum][chunkY * 4 + chunkX];
                     for (int metatileY = 0; metatileY < 4; metatileY++) {
                         for (int metatileX = 0; metatileX < 4; metatileX++) {
-                            Uint16 metatileNum = mapData->chunks[chunkNum][metatileY * 4 + metatileX];
+                            Uint16 metatileNum = data->chunks[chunkNum][metatileY * 4 + metatileX];
                             int xPos = (screenX * 16) + (chunkX * 4) + metatileX;
                             int yPos = (screenY * 16) + (chunkY * 4) + metatileY;
-                            mapMetatiles[yPos * roomWidthMetatiles + xPos] = metatileNum;
+                            room->metatiles[yPos * widthMetatiles + xPos] = metatileNum;
                         }
                     }
                 }
             }
         }
     }
+}
+
+static void Map_BuildPlanes(Room *room) {
+    Uint8 widthMetatiles = room->width * SCREEN_WIDTH_METATILES;
+    Uint16 mapBound = widthMetatiles * (room->height * SCREEN_HEIGHT_METATILES);
+    Uint16 *metatiles = room->metatiles;
+    Uint8 (*planes)[MAP_PLANE_BYTES] = room->planes;
+
+    // everything outside the room is solid ground
+    memset(planes[MAP_PLANE_SOLID], 0xff, MAP_PLANE_BYTES);
+    memset(planes[MAP_PLANE_LADDER], 0, MAP_PLANE_BYTES);
+    memset(planes[MAP_PLANE_SCENERY], 0, MAP_PLANE_BYTES);
+    memset(planes[MAP_PLANE_GROUND_BELOW], 0xff, MAP_PLANE_BYTES);
+    memset(planes[MAP_PLANE_GROUND_ABOVE], 0xff, MAP_PLANE_BYTES);
+
+    for (Uint16 offset = 0; offset < mapBound; offset++) {
+        Uint16 metatile = metatiles[offset];
+        Map_SetBit(planes[MAP_PLANE_SOLID], offset, metatile < MAP_SOLID);
+        Map_SetBit(planes[MAP_PLANE_LADDER], offset, (metatile >= MAP_SOLID) && (metatile < MAP_LADDER));
+        Map_SetBit(planes[MAP_PLANE_SCENERY], offset, metatile >= MAP_LADDER);
+
+        // on top of a solid tile or ladder, only solid tiles count as ground.
+        // otherwise, ladders are solid from the top too.
+        Uint16 limit = (metatile < MAP_LADDER) ? MAP_SOLID : MAP_LADDER;
+        Uint16 below = offset + widthMetatiles;
+        Uint16 above = offset - widthMetatiles;
+        Map_SetBit(planes[MAP_PLANE_GROUND_BELOW], offset, Map_ReadGround(metatiles, below, mapBound, limit));
+        Map_SetBit(planes[MAP_PLANE_GROUND_ABOVE], offset, Map_ReadGround(metatiles, above, mapBound, limit));
+    }
+
+    // mirror the start of each plane past the end so Map_GetBits can wrap
+    for (int i = 0; i < MAP_NUM_PLANES; i++) {
+        memcpy(&planes[i][0x10000 / 8], &planes[i][0], MAP_PLANE_BYTES - (0x10000 / 8));
+    }
+}
+
+static void Map_BuildDoorGrid(MapData *data, Uint8 roomNum) {
+    Sint16 (*grid)[MAP_DOOR_GRID_SIZE] = data->rooms[roomNum].doorGrid;
+    memset(grid, 0xff, MAP_DOOR_GRID_SIZE * sizeof(grid[0]));
+
+    for (int i = 0; i < data->numWarpDoors; i++) {
+        WarpDoor *door = &data->warpDoors[i];
+        if (door->roomNum != roomNum) { continue; }
+        // Map_Door used to take the first matching entry in the table
+        Sint16 *cell = &grid[door->yPos >> 2][door->xPos >> 2];
+        if (*cell < 0) { *cell = (Sint16)i; }
+    }
+}
+
+static void Map_LoadRooms(MapData *data, Arena *arena) {
+    for (int i = 0; i < data->numRooms; i++) {
+        Room *room = &data->rooms[i];
+        int size = (room->width * SCREEN_WIDTH_METATILES) * (room->height * SCREEN_HEIGHT_METATILES);
+
+        room->metatiles = Arena_Alloc(arena, size * sizeof(Uint16));
+        room->planes = Arena_Alloc(arena, MAP_NUM_PLANES * sizeof(room->planes[0]));
+        room->doorGrid = Arena_Alloc(arena, MAP_DOOR_GRID_SIZE * sizeof(room->doorGrid[0]));
+        Map_DecompressRoom(data, room);
+        Map_BuildPlanes(room);
+        Map_BuildDoorGrid(data, (Uint8)i);
+    }
+}
+
+void Map_LoadData(Uint8 gameType) {
+    MapCache *cache = &mapCaches[(gameType == GAME_TYPE_ARCADE) ? MAP_LAYOUT_ARCADE : MAP_LAYOUT_CONSOLE];
+
+    if (!cache->data) {
+        Arena_Init(&cache->arena, MAP_ARENA_BLOCK_SIZE);
+        if (gameType == GAME_TYPE_ARCADE) {
+            cache->data = Rom_GetMapDataArcade(&cache->arena);
+        }
+        else {
+            cache->data = Rom_GetMapData(&cache->arena);
+        }
+        Map_LoadRooms(cache->data, &cache->arena);
+        for (int i = 0; i < cache->data->numTilesets; i++) {
+            Tileset *tileset = &cache->data->tilesets[i];
+            cache->metatiles[i] = Arena_Alloc(&cache->arena, tileset->len * sizeof(Metatile));
+            memcpy(cache->metatiles[i], tileset->metatiles, tileset->len * sizeof(Metatile));
+        }
+    }
+    else {
+        // undo any door animation that was in progress when the last game ended
+        for (int i = 0; i < cache->data->numTilesets; i++) {
+            Tileset *tileset = &cache->data->tilesets[i];
+            memcpy(tileset->metatiles, cache->metatiles[i], tileset->len * sizeof(Metatile));
+        }
+    }
+
+    mapData = cache->data;
+    // make sure the next Map_Init loads the room from the new map data
+    currRoom = 0xff;
+}
+
+void Map_Init(Uint8 roomNum) {
+    if (roomNum == currRoom) { return; }
+
+    currRoom = roomNum;
+    Room *room = &mapData->rooms[currRoom];
+    roomWidthMetatiles = room->width * SCREEN_WIDTH_METATILES;
+    roomHeightMetatiles = room->height * SCREEN_HEIGHT_METATILES;
+    // rooms are decompressed by Map_LoadRooms, so all we have to do is swap
+    // pointers
+    mapMetatiles = room->metatiles;
+    mapPlanes = room->planes;
 
     // load the room's palettes
     Map_LoadPalettes(roomNum);
@@ -120,7 +237,7 @@ Uint16 Map_CheckX(Object *o) {
         collision++;
     }
 
-    if (mapMetatiles[collision] < MAP_SOLID) {
+    if (Map_TestBit(MAP_PLANE_SOLID, collision)) {
         // solid tile, so make the object snap to the metatile boundary
         goto found_tile;
     }
@@ -138,7 +255,7 @@ Uint16 Map_CheckX(Object *o) {
         return 0;
     }
 
-    if (mapMetatiles[collision] < MAP_SOLID) {
+    if (Map_TestBit(MAP_PLANE_SOLID, collision)) {
         goto found_tile;
     }
     return 0;
@@ -174,7 +291,7 @@ Uint16 Map_CheckY(Object *o) {
         collision += roomWidthMetatiles;
     }
 
-    if (mapMetatiles[collision] < MAP_SOLID) {
+    if (Map_TestBit(MAP_PLANE_SOLID, collision)) {
         goto found_tile;
     }
 
@@ -193,7 +310,7 @@ Uint16 Map_CheckY(Object *o) {
         return 0;
     }
 
-    if (mapMetatiles[collision] < MAP_SOLID) {
+    if (Map_TestBit(MAP_PLANE_SOLID, collision)) {
         goto found_tile;
     }
     return 0;
@@ -205,86 +322,32 @@ found_tile:
 }
 
 Uint16 Map_SolidTileBelow(Uint16 offset) {
-    Uint16 mapBound = roomWidthMetatiles * roomHeightMetatiles;
-    if (offset >= mapBound) { return 1; }
-    Uint16 metatile = mapMetatiles[offset];
-    // are we on top of a solid tile or a ladder?
-    if (metatile < MAP_LADDER) {
-        // look down a metatile
-        offset += roomWidthMetatiles;
-        if (offset >= mapBound) { return 1; }
-        metatile = mapMetatiles[offset];
-        // are we on top of a solid tile (not a ladder)?
-        if (metatile < MAP_SOLID) {
-            return 1;
-        }
-    }
-    else {
-        offset += roomWidthMetatiles;
-        if (offset >= mapBound) { return 1; }
-        metatile = mapMetatiles[offset];
-        // are we on top of a solid block or ladder? ladders are solid from the
-        // top
-        if (metatile < MAP_LADDER) {
-            return 1;
-        }
-    }
-    return 0;
+    return Map_TestBit(MAP_PLANE_GROUND_BELOW, offset);
 }
 
-  Uint16 Map_SolidTileAbove(Uint16 offset) {
-    Uint16 mapBound = roomWidthMetatiles * roomHeightMetatiles;
-      if (offset >= mapBound) { return 1; }
-      Uint16 metatile = mapMetatiles[offset];
-      // are we on top of a solid tile or a ladder?
-      if (metatile < MAP_LADDER) {
-          // look up a metatile
-          offset -= roomWidthMetatiles;
-          if (offset >= mapBound) { return 1; }
-          metatile = mapMetatiles[offset];
-          // are we on top of a solid tile (not a ladder)?
-          if (metatile < MAP_SOLID) {
-              return 1;
-          }
-      }
-      else {
-          offset -= roomWidthMetatiles;
-          if (offset >= mapBound) { return 1; }
-          metatile = mapMetatiles[offset];
-          // are we on top of a solid block or ladder? ladders are solid from the
-          // top
-          if (metatile < MAP_LADDER) {
-              return 1;
-          }
-      }
-      return 0;
-  }
+Uint16 Map_SolidTileAbove(Uint16 offset) {
+    return Map_TestBit(MAP_PLANE_GROUND_ABOVE, offset);
+}
 
 int Map_Door(Object *o) {
-    Uint8 chunkAlignedX = o->x.f.h & 0xfc;
-    Uint8 chunkAlignedY = o->y.f.h & 0xfc;
-
-    for (int i = 0; i < mapData->numWarpDoors; i++) {
-        Uint8 chunkAlignedDoorX = mapData->warpDoors[i].xPos & 0xfc;
-        Uint8 chunkAlignedDoorY = mapData->warpDoors[i].yPos & 0xfc;
-        if ((mapData->warpDoors[i].roomNum == currRoom) &&
-            (chunkAlignedDoorX == chunkAlignedX) &&
-            (chunkAlignedDoorY == chunkAlignedY))
-        {
-                // ending door
-                if (i == 0) {
-                    return DOOR_ENDING;
-                }
-                int doorIndex = i ^ 1;
-                o->x.f.l = 0x80;
-                o->y.f.l = 0x80;
-                o->x.f.h = mapData->warpDoors[doorIndex].xPos;
-                o->y.f.h = mapData->warpDoors[doorIndex].yPos;
-                return mapData->warpDoors[doorIndex].roomNum;
-        }
+    Uint8 chunkX = ((Uint8)o->x.f.h) >> 2;
+    Uint8 chunkY = ((Uint8)o->y.f.h) >> 2;
+
+    int i = mapData->rooms[currRoom].doorGrid[chunkY][chunkX];
+    if (i < 0) {
+        return DOOR_INVALID;
     }
 
-    return DOOR_INVALID;
+    // ending door
+    if (i == 0) {
+        return DOOR_ENDING;
+    }
+    int doorIndex = i ^ 1;
+    o->x.f.l = 0x80;
+    o->y.f.l = 0x80;
+    o->x.f.h = mapData->warpDoors[doorIndex].xPos;
+    o->y.f.h = mapData->warpDoors[doorIndex].yPos;
+    return mapData->warpDoors[doorIndex].roomNum;
 }
 
 void Map_SetPos(Uint16 x, Uint16 y) {
@@ -293,6 +356,8 @@ void Map_SetPos(Uint16 x, Uint16 y) {
 }
 
 void Map_Draw(void) {
+    if (!renderFrame) { return; }
+
     Uint16 tileset = mapData->rooms[currRoom].tileset;
 
     for (int y = 0; y < SCREEN_HEIGHT + METATILE_SIZE; y += METATILE_SIZE) {
@@ -311,3 +376,29 @@ void Map_Draw(void) {
         }
     }
 }
+
+void Map_SaveSnapshot(Buffer *buf) {
+    Buffer_AddData(buf, &currRoom, sizeof(currRoom));
+    Buffer_AddData(buf, (Uint8 *)&scrollX, sizeof(scrollX));
+    Buffer_AddData(buf, (Uint8 *)&scrollY, sizeof(scrollY));
+    for (int i = 0; i < mapData->numTilesets; i++) {
+        Tileset *tileset = &mapData->tilesets[i];
+        Buffer_AddData(buf, (Uint8 *)tileset->metatiles, tileset->len * sizeof(Metatile));
+    }
+}
+
+int Map_LoadSnapshot(Buffer *buf, int index) {
+    Uint8 roomNum = buf->data[index++];
+    // rooms are already decompressed, so this is cheap
+    Map_Init(roomNum);
+    Buffer_ReadData(buf, index, &scrollX, sizeof(scrollX));
+    index += sizeof(scrollX);
+    Buffer_ReadData(buf, index, &scrollY, sizeof(scrollY));
+    index += sizeof(scrollY);
+    for (int i = 0; i < mapData->numTilesets; i++) {
+        Tileset *tileset = &mapData->tilesets[i];
+        Buffer_ReadData(buf, index, tileset->metatiles, tileset->len * sizeof(Metatile));
+        index += tileset->len * sizeof(Metatile);
+    }
+    return index;
+}
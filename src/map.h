@@ -18,8 +18,12 @@
  */
 
 #pragma once
+#include "alloc.h"
+#include "buffer.h"
 #include "graphics.h"
-#include "object.h"
+
+// defined in object.h (which includes this file)
+typedef struct Object Object;
 
 typedef struct {
     Uint16 palnum;
@@ -44,6 +48,31 @@ typedef struct {
     Uint8 count;
 } SpawnInfo;
 
+// Per-room collision bit-planes, built by Map_LoadRooms. Each plane has one
+// bit per map offset and covers the whole Uint16 offset range, so offsets past
+// the end of the room (including ones that wrapped around below 0) land in a
+// border that reads the same way the old bounds checks did.
+typedef enum {
+    // metatile < MAP_SOLID (border is solid)
+    MAP_PLANE_SOLID = 0,
+    // MAP_SOLID <= metatile < MAP_LADDER (border is not a ladder)
+    MAP_PLANE_LADDER,
+    // metatile >= MAP_LADDER (border is not scenery)
+    MAP_PLANE_SCENERY,
+    // precomputed Map_SolidTileBelow result for each offset
+    MAP_PLANE_GROUND_BELOW,
+    // precomputed Map_SolidTileAbove result for each offset
+    MAP_PLANE_GROUND_ABOVE,
+    MAP_NUM_PLANES,
+} MAP_PLANE;
+
+// one bit per Uint16 offset, plus a few bytes that mirror the start of the
+// plane so multi-bit reads can wrap from offset 0xffff to 0
+#define MAP_PLANE_BYTES (0x10000 / 8 + 4)
+
+// warp doors are looked up by chunk (x and y position divided by 4)
+#define MAP_DOOR_GRID_SIZE 64
+
 typedef struct {
     // which tileset to use
     Uint16 tileset;
@@ -56,6 +85,12 @@ typedef struct {
     Uint16 *screenNums;
     // which enemy (object number) should go to each screen
     SpawnInfo spawns[64];
+    // decompressed metatiles (built by Map_LoadRooms)
+    Uint16 *metatiles;
+    // collision planes for the decompressed metatiles
+    Uint8 (*planes)[MAP_PLANE_BYTES];
+    // index into warpDoors for each chunk, or -1 if there's no door there
+    Sint16 (*doorGrid)[MAP_DOOR_GRID_SIZE];
 } Room;
 
 typedef struct {
@@ -114,11 +149,42 @@ extern Uint8 roomHeightMetatiles;
 #define MAP_LADDER (0x24)
 extern Uint16 *mapMetatiles;
 
+// collision planes for the current room
+extern Uint8 (*mapPlanes)[MAP_PLANE_BYTES];
+
+/**
+ * @brief Tests a single bit in a collision plane
+ * @param plane the plane to look at
+ * @param offset the map offset to test
+ * @returns 1 if the bit is set, 0 if it isn't
+ */
+static inline int Map_TestBit(MAP_PLANE plane, Uint16 offset) {
+    return (mapPlanes[plane][offset >> 3] >> (offset & 7)) & 1;
+}
+
 /**
- * @brief Frees a heap-allocated MapData struct
- * @param data struct to free
+ * @brief Reads a run of consecutive bits from a collision plane
+ * @param plane the plane to look at
+ * @param offset the map offset of the first bit
+ * @returns the plane bits starting at offset in the low bits (at least 25 bits
+ * are valid), ready to be masked
  */
-void Map_FreeData(MapData *data);
+static inline Uint32 Map_GetBits(MAP_PLANE plane, Uint16 offset) {
+    const Uint8 *bytes = &mapPlanes[plane][offset >> 3];
+    Uint32 bits = (Uint32)bytes[0] | ((Uint32)bytes[1] << 8) |
+                  ((Uint32)bytes[2] << 16) | ((Uint32)bytes[3] << 24);
+    return bits >> (offset & 7);
+}
+
+/**
+ * @brief Points mapData at the map data for the given game type. The first
+ * time a game type is played, this loads its map data from the ROM, decompresses
+ * every room and builds the rooms' collision planes and door lookup grids. After
+ * that the map data is kept (in an arena per game type), so later calls only
+ * undo the level end door animation's edits to the tilesets.
+ * @param gameType the game type (GAME_TYPE_ORIGINAL, GAME_TYPE_PLUS or GAME_TYPE_ARCADE)
+ */
+void Map_LoadData(Uint8 gameType);
 
 /**
  * @brief Loads a room from the map data
@@ -194,3 +260,19 @@ void Map_SetPos(Uint16 x, Uint16 y);
  * @brief Draws the map to the screen
 */
 void Map_Draw(void);
+
+/**
+ * @brief Adds the current room, scroll position, and tilesets (which the door
+ * animations edit) to a state snapshot
+ * @param buf buffer to add to
+ */
+void Map_SaveSnapshot(Buffer *buf);
+
+/**
+ * @brief Restores the map state from a state snapshot, switching rooms if
+ * necessary
+ * @param buf buffer to read from
+ * @param index where the map state starts in the buffer
+ * @returns the index right after the map state
+ */
+int Map_LoadSnapshot(Buffer *buf, int index);
@@ -18,6 +18,7 @@
  */
 
 #include <ctype.h>
+#include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdnoreturn.h>
@@ -30,21 +31,6 @@
 #include "mml.h"
 #include "sound.h"
 
-static FILE *infile;
-
-// used for keeping track of where we are in the input file for error messages
-static int line;
-static int column;
-// gets used instead of reading a character from the input file if it's not NO_CH
-#define NO_CH -2
-static int nextCh;
-// which apu we're using (0 or 1), set by the A command
-static int apu;
-// how many frames (1 frame = 1/60 second) a 16th note (smallest note we support) should take, set by the t command
-static int tempo;
-// default note length, set by the f command
-static int defaultLength;
-
 // we error out when we hit this cursor number (65535 not 655366 because the sound engine uses a cursor value of 65535
 // as an "instrument not playing" flag)
 #define CURSOR_LIMIT 65535
@@ -78,82 +64,103 @@ typedef struct {
 #define NUM_CHANNELS 4
 // maximum number of instruments the sound engine supports
 #define NUM_INSTRUMENTS 6
-static InstData instruments[NUM_INSTRUMENTS];
 
-static noreturn void errorExit(char *message) {
-    printf("Line %d column %d: %s\n", line, column, message);
-    exit(-1);
+// all the state for a single compile, so multiple compiles can run at once
+typedef struct {
+    // MML text we're reading from
+    const char *cursor;
+    const char *end;
+    // used for keeping track of where we are in the input file for error messages
+    int line;
+    int column;
+    // which apu we're using (0 or 1), set by the A command
+    int apu;
+    // how many frames (1 frame = 1/60 second) a 16th note (smallest note we support) should take, set by the t command
+    int tempo;
+    // default note length, set by the f command
+    int defaultLength;
+    InstData instruments[NUM_INSTRUMENTS];
+    // where to report errors to
+    MMLError *error;
+    // errorExit jumps back here
+    jmp_buf errorJmp;
+} MMLContext;
+
+static noreturn void errorExit(MMLContext *ctx, char *message) {
+    ctx->error->line = ctx->line;
+    ctx->error->column = ctx->column;
+    snprintf(ctx->error->message, sizeof(ctx->error->message), "%s", message);
+    longjmp(ctx->errorJmp, 1);
 }
 
-static void initInstrument(int num) {
-    instruments[num].enabled = 1;
-    instruments[num].outBuff = Buffer_Init(256);
-    instruments[num].cursor = 0;
-    instruments[num].loopPoint = -1;
-    instruments[num].loopPos = -1;
-    instruments[num].channel = -1;
-    instruments[num].reg1 = -1;
-    instruments[num].reg0 = -1;
-    instruments[num].octave = -1;
-    instruments[num].frames = 0;
-    instruments[num].loopFrames = 0;
+static void initInstrument(MMLContext *ctx, int num) {
+    ctx->instruments[num].enabled = 1;
+    ctx->instruments[num].outBuff = Buffer_Init(256);
+    ctx->instruments[num].cursor = 0;
+    ctx->instruments[num].loopPoint = -1;
+    ctx->instruments[num].loopPos = -1;
+    ctx->instruments[num].channel = -1;
+    ctx->instruments[num].reg1 = -1;
+    ctx->instruments[num].reg0 = -1;
+    ctx->instruments[num].octave = -1;
+    ctx->instruments[num].frames = 0;
+    ctx->instruments[num].loopFrames = 0;
 }
 
-static void nextLine(void) {
-    int ch;
-    while (1) {
-        ch = getc(infile);
-        if ((ch == EOF) || (ch == '\n')) {
+static void nextLine(MMLContext *ctx) {
+    while (ctx->cursor < ctx->end) {
+        if (*ctx->cursor++ == '\n') {
             break;
         }
     }
-    column = 0;
-    line++;
+    ctx->column = 0;
+    ctx->line++;
 }
 
 /**
- * @brief Gets the next character out of the file
+ * @brief Gets the next character out of the MML text
  * @param whitespace nonzero if you want to get whitespace, 0 if you want to skip whitespace
- * @returns the next character from the file
+ * @returns the next character from the MML text, or EOF at the end of it
  */
-static int readCh(int whitespace) {
+static int readCh(MMLContext *ctx, int whitespace) {
     int ch;
 
     while (1) {
-        if (nextCh != NO_CH) {
-            ch = nextCh;
-            nextCh = NO_CH;
+        if (ctx->cursor < ctx->end) {
+            ch = (unsigned char)*ctx->cursor++;
         }
         else {
-            ch = getc(infile);
+            ch = EOF;
         }
         if (ch == '\n') {
-            column = 0;
-            line++;
+            ctx->column = 0;
+            ctx->line++;
         }
-        else { column++; }
+        else { ctx->column++; }
         if ((ch == EOF) || whitespace || !isspace(ch)) { break; }
     }
     return ch;
 }
 
-static void pushCh(int ch) {
-    nextCh = ch;
-    column--;
+static void pushCh(MMLContext *ctx, int ch) {
+    // we're reading out of memory, so rather than saving the character we can
+    // just rewind to it
+    if (ch != EOF) { ctx->cursor--; }
+    ctx->column--;
 }
 
-static int readNum(void) {
+static int readNum(MMLContext *ctx) {
     char numStr[5] = {0};
     int numCursor = 0;
 
     // leave space for null terminator
     while (numCursor < (ARRAY_LEN(numStr) - 1)) {
-        int ch = readCh(0);
+        int ch = readCh(ctx, 0);
         if (isdigit(ch)) {
             numStr[numCursor++] = (char)ch;
         }
         else {
-            pushCh(ch);
+            pushCh(ctx, ch);
             if (numCursor == 0) {
                 return EOF;
             }
@@ -162,22 +169,22 @@ static int readNum(void) {
             }
         }
     }
-    errorExit("Number too large");
+    errorExit(ctx, "Number too large");
 }
 
-static int readHex(void) {
+static int readHex(MMLContext *ctx) {
     char hexStr[3] = {0};
     int hexCursor = 0;
 
     while (hexCursor < (ARRAY_LEN(hexStr) - 1)) {
         // we care about whitespace because some note commands are also valid hex digits so we want a space to
         // terminate the hex string
-        int ch = readCh(1);
+        int ch = readCh(ctx, 1);
         if (isxdigit(ch)) {
             hexStr[hexCursor++] = (char)ch;
         }
         else {
-            pushCh(ch);
+            pushCh(ctx, ch);
             break;
         }
     }
@@ -189,64 +196,64 @@ static int readHex(void) {
     }
 }
 
-static int getNoteFrames(int noteNum) {
+static int getNoteFrames(MMLContext *ctx, int noteNum) {
     // valid notes: powers of 2 between 1 and 16
     if ((noteNum >= 1) && (noteNum <= 16) && ((noteNum & (noteNum - 1)) == 0)) {
-        int frames = tempo * (16 / noteNum);
+        int frames = ctx->tempo * (16 / noteNum);
         // handle dotted notes
         int originalNote = frames;
         int ch;
         for (int i = 0; i < 3; i++) {
-            ch = readCh(0);
+            ch = readCh(ctx, 0);
             if (ch == '.') {
                 originalNote /= 2;
                 frames += originalNote;
             }
             else {
-                pushCh(ch);
+                pushCh(ctx, ch);
                 return frames;
             }
         }
-        errorExit("Too many dots on note (max 3)");
+        errorExit(ctx, "Too many dots on note (max 3)");
     }
     else {
-        errorExit("Invalid note duration");
+        errorExit(ctx, "Invalid note duration");
     }
 }
 
-static int noteToFrames(void) {
-    if (tempo <= 0) { errorExit("Tempo must be set with t command"); }
-    int noteNum = readNum();
+static int noteToFrames(MMLContext *ctx) {
+    if (ctx->tempo <= 0) { errorExit(ctx, "Tempo must be set with t command"); }
+    int noteNum = readNum(ctx);
     if (noteNum < 0) {
-        if (defaultLength > 0) {
-            return defaultLength;
+        if (ctx->defaultLength > 0) {
+            return ctx->defaultLength;
         }
         else {
-            errorExit("Default note length must be set with l command");
+            errorExit(ctx, "Default note length must be set with l command");
         }
     }
-    int frames = getNoteFrames(noteNum);
+    int frames = getNoteFrames(ctx, noteNum);
     // handle tie(s)
-    int ch = readCh(0);
+    int ch = readCh(ctx, 0);
     while (ch == '^') {
-        noteNum = readNum();
+        noteNum = readNum(ctx);
         if (noteNum < 0) {
-            errorExit("Note not specified for tie");
+            errorExit(ctx, "Note not specified for tie");
         }
         else {
-            frames += getNoteFrames(noteNum);
+            frames += getNoteFrames(ctx, noteNum);
         }
-	ch = readCh(0);
+	ch = readCh(ctx, 0);
     }
-    pushCh(ch);
+    pushCh(ctx, ch);
     if (frames >= 65536) {
-        errorExit("Note duration too long (max: 65535 frames)");
+        errorExit(ctx, "Note duration too long (max: 65535 frames)");
     }
     return frames;
 }
 
-static void checkInst(InstData *i) {
-    if (!i) { errorExit("Instrument number must be defined with the I command."); }
+static void checkInst(MMLContext *ctx, InstData *i) {
+    if (!i) { errorExit(ctx, "Instrument number must be defined with the I command."); }
 }
 
 static void addInstFrames(InstData *i, int frames) {
@@ -258,33 +265,19 @@ static void addInstFrames(InstData *i, int frames) {
     }
 }
 
-static void writeCmd(InstData *i, Uint8 cmd, Uint16 param) {
-    checkInst(i);
-    if (apu < 0) { errorExit("APU number must be set with A command"); }
-    if ((i->reg0 < 0) || (i->reg1 < 0)) { errorExit("APU registers 0 & 1 must be initialized with R0 & R1 commands"); }
-    if (i->channel < 0) { errorExit("APU channel must be initialized with C command"); }
+static void writeCmd(MMLContext *ctx, InstData *i, Uint8 cmd, Uint16 param) {
+    checkInst(ctx, i);
+    if (ctx->apu < 0) { errorExit(ctx, "APU number must be set with A command"); }
+    if ((i->reg0 < 0) || (i->reg1 < 0)) { errorExit(ctx, "APU registers 0 & 1 must be initialized with R0 & R1 commands"); }
+    if (i->channel < 0) { errorExit(ctx, "APU channel must be initialized with C command"); }
     Buffer_Add(i->outBuff, cmd);
     Buffer_AddUint16(i->outBuff, param);
     i->cursor++;
-    if (i->cursor >= CURSOR_LIMIT) { errorExit("Song too long"); }
+    if (i->cursor >= CURSOR_LIMIT) { errorExit(ctx, "Song too long"); }
 }
 
-int MML_Compile(const char *filename, Sound *sound){
-    // input file
-    infile = File_OpenResource(filename, "r");
-    if (!infile) {
-        return 0;
-    }
-    printf("--- Compiling %s ---\n", filename);
-
-    // initialize compiler state
-    line = 1;
-    column = 0;
-    nextCh = NO_CH;
-    apu = -1;
-    tempo = -1;
-    defaultLength = -1;
-
+// does the actual compiling, any errors longjmp back out to MML_CompileMem
+static void compile(MMLContext *ctx, Sound *sound) {
     int ch;
     int note;
     int frames;
@@ -292,66 +285,66 @@ int MML_Compile(const char *filename, Sound *sound){
     Uint8 noiseList[256];
     int instNum;
     InstData *inst = NULL;
-    while (!feof(infile)) {
-        ch = readCh(0);
+    while (ctx->cursor < ctx->end) {
+        ch = readCh(ctx, 0);
         switch (ch) {
         case EOF: break;
 
         // comment
         case ';':
-            nextLine();
+            nextLine(ctx);
             break;
 
         // loop start
         case '[':
-            checkInst(inst);
+            checkInst(ctx, inst);
             if (inst->loopPos < 0) {
                 inst->loopPos = inst->cursor;
             }
             else {
-                errorExit("Nested loops aren't allowed");
+                errorExit(ctx, "Nested loops aren't allowed");
             }
             break;
 
         // loop end
         case ']':
-            checkInst(inst);
+            checkInst(ctx, inst);
             if (inst->loopPos >= 0) {
-                int loopCount = readNum();
+                int loopCount = readNum(ctx);
                 if ((loopCount >= 2) && (loopCount <= 16)) {
                     // b0 = loop command
-                    writeCmd(inst, 0xb0 | (loopCount - 2), inst->loopPos);
+                    writeCmd(ctx, inst, 0xb0 | (loopCount - 2), inst->loopPos);
                     inst->loopPos = -1;
                     inst->frames += (inst->loopFrames * loopCount);
                     inst->loopFrames = 0;
                 }
                 else {
-                    errorExit("Loop count must be between 2 and 16");
+                    errorExit(ctx, "Loop count must be between 2 and 16");
                 }
             }
             break;
 
         // up octave
         case '>':
-            checkInst(inst);
+            checkInst(ctx, inst);
             if ((inst->octave >= 1) && (inst->octave <= 8)) {
                 inst->octave++;
-                if (inst->octave > 8) { errorExit("Octave must be between 1 and 8"); }
+                if (inst->octave > 8) { errorExit(ctx, "Octave must be between 1 and 8"); }
             }
             else {
-                errorExit("Octave must be initialized with o command");
+                errorExit(ctx, "Octave must be initialized with o command");
             }
             break;
 
         // down octave
         case '<':
-            checkInst(inst);
+            checkInst(ctx, inst);
             if ((inst->octave >= 1) && (inst->octave <= 8)) {
                 inst->octave--;
-                if (inst->octave < 1) { errorExit("Octave must be between 1 and 8"); }
+                if (inst->octave < 1) { errorExit(ctx, "Octave must be between 1 and 8"); }
             }
             else {
-                errorExit("Octave must be initialized with o command");
+                errorExit(ctx, "Octave must be initialized with o command");
             }
             break;
 
@@ -371,46 +364,46 @@ int MML_Compile(const char *filename, Sound *sound){
         case 'b':
             note = 11;
         doneNote:;
-            checkInst(inst);
-            int sharp = readCh(0);
+            checkInst(ctx, inst);
+            int sharp = readCh(ctx, 0);
             if (sharp == '#') {
                 sharp = 1;
                 if ((ch == 'e') || (ch == 'b')) {
-                    errorExit("Only c#, d#, f#, g#, and a# are permitted sharp notes");
+                    errorExit(ctx, "Only c#, d#, f#, g#, and a# are permitted sharp notes");
                 }
             }
             else {
-                pushCh(sharp);
+                pushCh(ctx, sharp);
                 sharp = 0;
             }
             note += sharp;
-            frames = noteToFrames();
-            writeCmd(inst, (inst->octave - 1) << 4 | note, frames);
+            frames = noteToFrames(ctx);
+            writeCmd(ctx, inst, (inst->octave - 1) << 4 | note, frames);
             addInstFrames(inst, frames);
             break;
 
         // APU number
         case 'A':
-            if (apu >= 0) { errorExit("APU number can't be changed"); }
-            int apuNum = readNum();
+            if (ctx->apu >= 0) { errorExit(ctx, "APU number can't be changed"); }
+            int apuNum = readNum(ctx);
             if ((apuNum == 0) || (apuNum == 1)) {
-                apu = apuNum;
+                ctx->apu = apuNum;
             }
             else {
-                errorExit("APU number must be 0 or 1");
+                errorExit(ctx, "APU number must be 0 or 1");
             }
             break;
 
         // APU channel number
         case 'C':
-            checkInst(inst);
-            int channelNum = readNum();
+            checkInst(ctx, inst);
+            int channelNum = readNum(ctx);
             if ((channelNum >= 0) && (channelNum < NUM_CHANNELS)) {
-                if (inst->channel >= 0) { errorExit("APU channel can't be changed"); }
+                if (inst->channel >= 0) { errorExit(ctx, "APU channel can't be changed"); }
                 inst->channel = channelNum;
             }
             else {
-                errorExit("Channel number must be between 0 and 3");
+                errorExit(ctx, "Channel number must be between 0 and 3");
             }
             break;
 
@@ -420,34 +413,34 @@ int MML_Compile(const char *filename, Sound *sound){
             if (inst && inst->frames && (inst->loopPos == -1)) {
                 printf("Instrument %d: %d frames\n", instNum, inst->frames);
             }
-            instNum = readNum();
+            instNum = readNum(ctx);
             if ((instNum >= 0) && (instNum < NUM_INSTRUMENTS)) {
-                inst = &instruments[instNum];
+                inst = &ctx->instruments[instNum];
                 if (!inst->enabled) {
-                    initInstrument(instNum);
+                    initInstrument(ctx, instNum);
                 }
             }
             else {
-                errorExit("Instrument number must be between 0 and 5");
+                errorExit(ctx, "Instrument number must be between 0 and 5");
             }
             break;
 
         // loop point
         case 'L':
-            checkInst(inst);
+            checkInst(ctx, inst);
             inst->loopPoint = inst->cursor;
             break;
 
         // default note length
         case 'l':
-            defaultLength = noteToFrames();
+            ctx->defaultLength = noteToFrames(ctx);
             break;
 
         // adds noise to list
         case 'N':;
-            int noiseToAdd = readHex();
+            int noiseToAdd = readHex(ctx);
             if ((noiseToAdd <= 0) || (noiseToAdd >= 0xff) || ((noiseToAdd >= 0xa0) && (noiseToAdd < 0xc0))) {
-                errorExit("Noise must be 0-a0 or c0-fe");
+                errorExit(ctx, "Noise must be 0-a0 or c0-fe");
             }
             int noiseFound = 0;
             for (int i = 0; i < numNoises; i++) {
@@ -463,47 +456,47 @@ int MML_Compile(const char *filename, Sound *sound){
 
         // plays noise
         case 'n':
-            checkInst(inst);
-            if (inst->channel != 3) { errorExit("Noise can only be played on APU channel 3"); }
-            int noiseToPlay = readNum();
+            checkInst(ctx, inst);
+            if (inst->channel != 3) { errorExit(ctx, "Noise can only be played on APU channel 3"); }
+            int noiseToPlay = readNum(ctx);
             if ((noiseToPlay < 0) || (noiseToPlay >= numNoises)) {
-                errorExit("Invalid noise number");
+                errorExit(ctx, "Invalid noise number");
             }
-            ch = readCh(0);
+            ch = readCh(ctx, 0);
             if (ch == ',') {
-                frames = noteToFrames();
+                frames = noteToFrames(ctx);
             }
             else {
-                frames = defaultLength;
-                pushCh(ch);
+                frames = ctx->defaultLength;
+                pushCh(ctx, ch);
             }
-            writeCmd(inst, noiseList[noiseToPlay], frames);
+            writeCmd(ctx, inst, noiseList[noiseToPlay], frames);
             addInstFrames(inst, frames);
             break;
 
         // octave specifier
         case 'o':
-            checkInst(inst);
-            inst->octave = readNum();
+            checkInst(ctx, inst);
+            inst->octave = readNum(ctx);
             if ((inst->octave < 1) || (inst->octave > 8)) {
-                errorExit("Octave must be between 1 and 8");
+                errorExit(ctx, "Octave must be between 1 and 8");
             }
             break;
 
         // register set
         case 'R':;
-            checkInst(inst);
-            int regNum = readNum();
+            checkInst(ctx, inst);
+            int regNum = readNum(ctx);
             if ((regNum != 0) && (regNum != 1)) {
-                errorExit("Register to set must be 0 or 1");
+                errorExit(ctx, "Register to set must be 0 or 1");
             }
-            ch = readCh(0);
+            ch = readCh(ctx, 0);
             if ((ch != ',') && (ch != ':')) {
-                errorExit("Register value not specified");
+                errorExit(ctx, "Register value not specified");
             }
-            int regVal = readHex();
+            int regVal = readHex(ctx);
             if ((regVal < 0) || (regVal > 255)) {
-                errorExit("Invalid register value");
+                errorExit(ctx, "Invalid register value");
             }
             if ((regNum == 0) && (inst->reg0 < 0)) {
                 inst->reg0 = regVal;
@@ -512,51 +505,49 @@ int MML_Compile(const char *filename, Sound *sound){
                 inst->reg1 = regVal;
             }
             else {
-                writeCmd(inst, 0xa0 + regNum, regVal);
+                writeCmd(ctx, inst, 0xa0 + regNum, regVal);
             }
             break;
 
         // rest
         case 'r':
-            frames = noteToFrames();
-            writeCmd(inst, 0x6f, frames);
+            frames = noteToFrames(ctx);
+            writeCmd(ctx, inst, 0x6f, frames);
             addInstFrames(inst, frames);
             break;
 
         // tempo specifier (how many frames a 16th note takes)
         case 't':
-            tempo = readNum();
-            if (tempo <= 0) {
-                errorExit("Tempo must be greater than 0");
+            ctx->tempo = readNum(ctx);
+            if (ctx->tempo <= 0) {
+                errorExit(ctx, "Tempo must be greater than 0");
             }
             break;
 
         // we shouldn't end up here
         default:
-            errorExit("Syntax error");
+            errorExit(ctx, "Syntax error");
         }
     }
 
-    fclose(infile);
-
     // print frame count for final instrument statement
     if (inst) {
         printf("Instrument %d: %d frames\n", instNum, inst->frames);
     }
 
     memset(sound, 0, sizeof(Sound));
-    sound->isMusic = apu;
+    sound->isMusic = ctx->apu;
 
     // finish up the instrument data
     for (int i = 0; i < NUM_INSTRUMENTS; i++) {
-        inst = &instruments[i];
+        inst = &ctx->instruments[i];
         if (inst->enabled) {
             if (inst->loopPoint >= 0) {
-                writeCmd(inst, 0xbf, inst->loopPoint);
+                writeCmd(ctx, inst, 0xbf, inst->loopPoint);
             }
             // "end of track" command
             else {
-                writeCmd(inst, 0xff, 0x00);
+                writeCmd(ctx, inst, 0xff, 0x00);
             }
             sound->count++;
         }
@@ -565,7 +556,7 @@ int MML_Compile(const char *filename, Sound *sound){
     sound->data = ommalloc(sound->count * sizeof(Instrument));
     int count = 0;
     for (int i = 0; i < NUM_INSTRUMENTS; i++) {
-        inst = &instruments[i];
+        inst = &ctx->instruments[i];
         if (inst->enabled) {
             sound->data[count].num = i;
             sound->data[count].data = inst->outBuff->data;
@@ -578,7 +569,55 @@ int MML_Compile(const char *filename, Sound *sound){
             count++;
         }
     }
+}
+
+int MML_CompileMem(const char *text, int len, Sound *sound, MMLError *error) {
+    // initialize compiler state
+    MMLContext *ctx = ommalloc(sizeof(MMLContext));
+    memset(ctx, 0, sizeof(MMLContext));
+    ctx->cursor = text;
+    ctx->end = text + len;
+    ctx->line = 1;
+    ctx->column = 0;
+    ctx->apu = -1;
+    ctx->tempo = -1;
+    ctx->defaultLength = -1;
+    ctx->error = error;
+
+    int success;
+    if (setjmp(ctx->errorJmp) == 0) {
+        compile(ctx, sound);
+        success = 1;
+    }
+    else {
+        // free any instrument data that didn't make it to the output
+        for (int i = 0; i < NUM_INSTRUMENTS; i++) {
+            if (ctx->instruments[i].enabled) {
+                Buffer_Destroy(ctx->instruments[i].outBuff);
+            }
+        }
+        memset(sound, 0, sizeof(Sound));
+        success = 0;
+    }
+    free(ctx);
+    return success;
+}
 
-    memset(instruments, 0, sizeof(instruments));
-    return 1;
+int MML_Compile(const char *filename, Sound *sound) {
+    FILE *fp = File_OpenResource(filename, "rb");
+    if (!fp) {
+        return 0;
+    }
+    printf("--- Compiling %s ---\n", filename);
+    int len;
+    char *text = (char *)File_Load(fp, &len);
+    fclose(fp);
+
+    MMLError error;
+    int success = MML_CompileMem(text, len, sound, &error);
+    if (!success) {
+        printf("Line %d column %d: %s\n", error.line, error.column, error.message);
+    }
+    free(text);
+    return success;
 }
@@ -20,6 +20,13 @@
 #pragma once
 #include "sound.h"
 
+typedef struct {
+    // where in the MML text the error happened
+    int line;
+    int column;
+    char message[128];
+} MMLError;
+
 /**
  * @brief Compiles the given MML file to bytecode
  * @param filename MML file to compile
@@ -27,3 +34,14 @@
  * @returns 1 on successful compile, 0 on failed compile
  */
 int MML_Compile(const char *filename, Sound *sound);
+
+/**
+ * @brief Compiles MML text that's already in memory to bytecode. Doesn't touch
+ * any global state, so it's safe to run several of these at once.
+ * @param text the MML text (doesn't need to be NUL terminated)
+ * @param len length of the MML text in bytes
+ * @param sound (out) where to write the sound metadata and bytecode (see sound.h)
+ * @param error (out) where to write the error details if the compile fails
+ * @returns 1 on successful compile, 0 on failed compile
+ */
+int MML_CompileMem(const char *text, int len, Sound *sound, MMLError *error);
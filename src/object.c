@@ -17,8 +17,15 @@
  * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
 
+#include "alloc.h"
 #include "biforce.h"
 #include "bospido.h"
 #include "boundball.h"
@@ -62,7 +69,13 @@
 #include "yokkochan.h"
 #include "zadofly.h"
 
-Object objects[MAX_OBJECTS];
+#ifdef OM_OBJECT_PROFILE
+#include "input.h"
+#include "nanotime.h"
+#endif
+
+Object *objects = NULL;
+int objectCapacity = 0;
 int currObjectIndex;
 
 typedef void (*OBJECT_FUNCTION)(Object *o);
@@ -165,42 +178,505 @@ OBJECT_FUNCTION objectFunctions[] = {
     Fireball_Obj,
 };
 
-#define ENEMY_SLOT (9)
+#define OBJECT_NAME(type) [type] = #type
+static const char *objectNames[NUM_OBJECTS] = {
+    OBJECT_NAME(OBJ_LUCIA_NORMAL),
+    OBJECT_NAME(OBJ_LUCIA_CLIMB),
+    OBJECT_NAME(OBJ_LUCIA_AIR_LOCKED),
+    OBJECT_NAME(OBJ_LUCIA_AIR),
+    OBJECT_NAME(OBJ_MAGIC_BOMB),
+    OBJECT_NAME(OBJ_SHIELD_BALL),
+    OBJECT_NAME(OBJ_BOUND_BALL),
+    OBJECT_NAME(OBJ_MAGIC_BOMB_FIRE),
+    OBJECT_NAME(OBJ_FLAME_SWORD_FIRE),
+    OBJECT_NAME(OBJ_EXPLOSION),
+    OBJECT_NAME(OBJ_SMASHER),
+    OBJECT_NAME(OBJ_SWORD),
+    OBJECT_NAME(OBJ_FLAME_SWORD),
+    OBJECT_NAME(OBJ_SMASHER_DAMAGE),
+    OBJECT_NAME(OBJ_NOMAJI_INIT),
+    OBJECT_NAME(OBJ_NIPATA_INIT),
+    OBJECT_NAME(OBJ_DOPIPU_INIT),
+    OBJECT_NAME(OBJ_KIKURA_INIT),
+    OBJECT_NAME(OBJ_PERASKULL_INIT),
+    OBJECT_NAME(OBJ_FIRE_INIT),
+    OBJECT_NAME(OBJ_MANTLE_SKULL_INIT),
+    OBJECT_NAME(OBJ_ZADOFLY_INIT),
+    OBJECT_NAME(OBJ_GAGUZUL_INIT),
+    OBJECT_NAME(OBJ_SPAJYAN_INIT),
+    OBJECT_NAME(OBJ_NYURU_INIT),
+    OBJECT_NAME(OBJ_NISHIGA_INIT),
+    OBJECT_NAME(OBJ_EYEMON_INIT),
+    OBJECT_NAME(OBJ_YOKKO_CHAN_INIT),
+    OBJECT_NAME(OBJ_HOPEGG_INIT),
+    OBJECT_NAME(OBJ_NIGITO_INIT),
+    OBJECT_NAME(OBJ_SUNEISA_INIT),
+    OBJECT_NAME(OBJ_JOYLIMER_INIT),
+    OBJECT_NAME(OBJ_HYPER_EYEMON_INIT),
+    OBJECT_NAME(OBJ_BIFORCE_INIT),
+    OBJECT_NAME(OBJ_BOSPIDO_INIT),
+    OBJECT_NAME(OBJ_DALTOS_INIT),
+    OBJECT_NAME(OBJ_NOMAJI),
+    OBJECT_NAME(OBJ_NIPATA),
+    OBJECT_NAME(OBJ_DOPIPU),
+    OBJECT_NAME(OBJ_KIKURA),
+    OBJECT_NAME(OBJ_PERASKULL),
+    OBJECT_NAME(OBJ_FIRE),
+    OBJECT_NAME(OBJ_MANTLE_SKULL),
+    OBJECT_NAME(OBJ_ZADOFLY),
+    OBJECT_NAME(OBJ_GAGUZUL),
+    OBJECT_NAME(OBJ_SPAJYAN),
+    OBJECT_NAME(OBJ_NYURU),
+    OBJECT_NAME(OBJ_NISHIGA),
+    OBJECT_NAME(OBJ_EYEMON),
+    OBJECT_NAME(OBJ_YOKKO_CHAN),
+    OBJECT_NAME(OBJ_HOPEGG),
+    OBJECT_NAME(OBJ_NIGITO),
+    OBJECT_NAME(OBJ_SUNEISA),
+    OBJECT_NAME(OBJ_JOYLIMER),
+    OBJECT_NAME(OBJ_BIFORCE),
+    OBJECT_NAME(OBJ_BOSPIDO),
+    OBJECT_NAME(OBJ_DALTOS),
+    OBJECT_NAME(OBJ_LUCIA_LVL_END_DOOR),
+    OBJECT_NAME(OBJ_LUCIA_WARP_DOOR),
+    OBJECT_NAME(OBJ_ITEM),
+    OBJECT_NAME(OBJ_BUNYON_INIT),
+    OBJECT_NAME(OBJ_BUNYON),
+    OBJECT_NAME(OBJ_BUNYON_SPLIT),
+    OBJECT_NAME(OBJ_MED_BUNYON_INIT),
+    OBJECT_NAME(OBJ_MED_BUNYON),
+    OBJECT_NAME(OBJ_MED_BUNYON_SPLIT),
+    OBJECT_NAME(OBJ_SMALL_BUNYON_INIT),
+    OBJECT_NAME(OBJ_SMALL_BUNYON),
+    OBJECT_NAME(OBJ_FOUNTAIN),
+    OBJECT_NAME(OBJ_LUCIA_DYING),
+    OBJECT_NAME(OBJ_WING_OF_MADOOLA),
+    OBJECT_NAME(OBJ_FIREBALL),
+};
+
+int Object_TypeFromName(const char *name) {
+    // allow leaving off the OBJ_ prefix
+    if (strncmp(name, "OBJ_", 4) == 0) { name += 4; }
+    for (int i = 0; i < NUM_OBJECTS; i++) {
+        if (objectNames[i] && (strcmp(objectNames[i] + 4, name) == 0)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Bitmap of object slots that are in use, so running and allocating objects
+// only has to look at the live ones. Object code sets the type field directly,
+// so this can have stale bits set for slots that have since been deleted
+// (they get cleared next time Object_ListRun gets to them), but a slot with a
+// nonzero type always has its bit set. Lucia & the weapon slots are always
+// marked as used because the weapon code fills them in directly.
+static Uint64 *usedSlots = NULL;
+// bumped every time a slot gets a new object, so handles to the slot's old
+// object can be told apart from handles to the new one
+static Uint16 *generations = NULL;
+// slots of order-independent objects that Object_ListRun hasn't run yet
+static Uint16 *deferredSlots = NULL;
+static int numDeferred = 0;
+// set when a deferred object drew sprites this frame, so they need to be put
+// back in slot order
+static int deferredDrew = 0;
+// set when Object_FindNext couldn't find a slot but the pool can grow
+static int growRequested = 0;
+
+// Resizes the object pool to the given number of slots. This moves the object
+// list in memory, so it must only be run when nothing has an Object pointer.
+static void Object_Resize(int capacity) {
+    objects = omrealloc(objects, capacity * sizeof(Object));
+
+    int words = capacity / 64;
+    usedSlots = omrealloc(usedSlots, words * sizeof(Uint64));
+    generations = omrealloc(generations, capacity * sizeof(Uint16));
+    deferredSlots = omrealloc(deferredSlots, capacity * sizeof(Uint16));
+    if (capacity > objectCapacity) {
+        int oldWords = objectCapacity / 64;
+        memset(objects + objectCapacity, 0, (capacity - objectCapacity) * sizeof(Object));
+        memset(usedSlots + oldWords, 0, (words - oldWords) * sizeof(Uint64));
+        memset(generations + objectCapacity, 0, (capacity - objectCapacity) * sizeof(Uint16));
+    }
+    objectCapacity = capacity;
+}
+
+static void Object_MarkUsed(int index) {
+    usedSlots[index / 64] |= ((Uint64)1 << (index % 64));
+}
+
+// gives a slot a new generation, skipping the reserved one
+static void Object_NewGeneration(int index) {
+    generations[index]++;
+    if (generations[index] == OBJECT_GENERATION_RESERVED) {
+        generations[index]++;
+    }
+}
+
+static int Object_IsReservedSlot(int index) {
+    return (index == OBJECT_SLOT_ITEM) || (index == OBJECT_SLOT_WING);
+}
+
+static void Object_MarkFree(int index) {
+    if (index >= ENEMY_SLOT) {
+        usedSlots[index / 64] &= ~((Uint64)1 << (index % 64));
+    }
+}
+
+static int Object_LowestBit(Uint64 word) {
+#if defined(__GNUC__)
+    return __builtin_ctzll(word);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return (int)index;
+#else
+    int index = 0;
+    while (!(word & 1)) {
+        word >>= 1;
+        index++;
+    }
+    return index;
+#endif
+}
+
+// returns the first used slot at or after index, or objectCapacity if there isn't one
+static int Object_NextUsed(int index) {
+    if (index >= objectCapacity) { return objectCapacity; }
+    int word = index / 64;
+    Uint64 bits = usedSlots[word] & (~(Uint64)0 << (index % 64));
+    while (!bits) {
+        if (++word >= (objectCapacity / 64)) { return objectCapacity; }
+        bits = usedSlots[word];
+    }
+    return (word * 64) + Object_LowestBit(bits);
+}
 
 void Object_ListInit(void) {
-    for (int i = 0; i < MAX_OBJECTS; i++) {
+    // go back to the normal pool size in case the last stage grew it
+    if (objectCapacity != MAX_OBJECTS) {
+        Object_Resize(MAX_OBJECTS);
+    }
+    growRequested = 0;
+    for (int i = 0; i < objectCapacity; i++) {
         objects[i].type = OBJ_NONE;
     }
+    memset(usedSlots, 0, (objectCapacity / 64) * sizeof(Uint64));
+    for (int i = 0; i < ENEMY_SLOT; i++) {
+        Object_MarkUsed(i);
+    }
+}
+
+ObjectHandle Object_GetHandle(Object *o) {
+    ObjectHandle handle;
+    handle.index = (Uint16)(o - objects);
+    handle.generation = generations[handle.index];
+    return handle;
+}
+
+Object *Object_FromHandle(ObjectHandle handle) {
+    if (handle.index >= objectCapacity) { return NULL; }
+    if (handle.generation == OBJECT_GENERATION_RESERVED) {
+        return &objects[handle.index];
+    }
+    if ((generations[handle.index] != handle.generation) ||
+        (objects[handle.index].type == OBJ_NONE))
+    {
+        return NULL;
+    }
+    return &objects[handle.index];
+}
+
+Object *Object_Get(ObjectHandle handle) {
+#ifndef NDEBUG
+    // catch code holding on to an object that's been deleted or replaced
+    Object *o = Object_FromHandle(handle);
+    assert(o);
+    return o;
+#else
+    return &objects[handle.index];
+#endif
+}
+
+// Object types that can run in any order relative to other objects. They
+// must not touch anything other objects read or write (RNG, weaponCoords,
+// luciaHurtPoints, Collision_Handle, sounds, other object slots...), or read
+// anything that objects later in the list can change this frame. The only
+// side effect other objects can see is freeing their own slot, which
+// Object_RunDeferred takes care of.
+// Every enemy's main object function uses Collision_Handle, so the enemies
+// that qualify are the initialization objects, which only set up their own
+// fields (and check the map to put themselves on the ground). Left out:
+// Joylimer and Nyuru play a sound, and Yokko-chan reads keywordDisplay, which
+// a Yokko-chan later in the list can set.
+static const Uint8 objectOrderIndependent[NUM_OBJECTS] = {
+    [OBJ_EXPLOSION] = 1,
+    [OBJ_NOMAJI_INIT] = 1,
+    [OBJ_NIPATA_INIT] = 1,
+    [OBJ_DOPIPU_INIT] = 1,
+    [OBJ_KIKURA_INIT] = 1,
+    [OBJ_PERASKULL_INIT] = 1,
+    [OBJ_FIRE_INIT] = 1,
+    [OBJ_MANTLE_SKULL_INIT] = 1,
+    [OBJ_ZADOFLY_INIT] = 1,
+    [OBJ_GAGUZUL_INIT] = 1,
+    [OBJ_SPAJYAN_INIT] = 1,
+    [OBJ_NISHIGA_INIT] = 1,
+    [OBJ_EYEMON_INIT] = 1,
+    [OBJ_HOPEGG_INIT] = 1,
+    [OBJ_NIGITO_INIT] = 1,
+    [OBJ_SUNEISA_INIT] = 1,
+    [OBJ_HYPER_EYEMON_INIT] = 1,
+    [OBJ_BIFORCE_INIT] = 1,
+    [OBJ_BOSPIDO_INIT] = 1,
+    [OBJ_DALTOS_INIT] = 1,
+    [OBJ_BUNYON_INIT] = 1,
+    [OBJ_MED_BUNYON_INIT] = 1,
+    [OBJ_SMALL_BUNYON_INIT] = 1,
+};
+
+void Object_SaveSnapshot(Buffer *buf) {
+    // deferred objects only exist in the middle of Object_ListRun
+    assert(numDeferred == 0);
+    Buffer_AddData(buf, (Uint8 *)&objectCapacity, sizeof(objectCapacity));
+    Buffer_AddData(buf, (Uint8 *)&currObjectIndex, sizeof(currObjectIndex));
+    Buffer_AddData(buf, (Uint8 *)&growRequested, sizeof(growRequested));
+    Buffer_AddData(buf, (Uint8 *)objects, objectCapacity * sizeof(Object));
+    Buffer_AddData(buf, (Uint8 *)usedSlots, (objectCapacity / 64) * sizeof(Uint64));
+    Buffer_AddData(buf, (Uint8 *)generations, objectCapacity * sizeof(Uint16));
+}
+
+int Object_LoadSnapshot(Buffer *buf, int index) {
+    int capacity;
+    Buffer_ReadData(buf, index, &capacity, sizeof(capacity));
+    index += sizeof(capacity);
+    if (capacity != objectCapacity) {
+        Object_Resize(capacity);
+    }
+
+    Buffer_ReadData(buf, index, &currObjectIndex, sizeof(currObjectIndex));
+    index += sizeof(currObjectIndex);
+    Buffer_ReadData(buf, index, &growRequested, sizeof(growRequested));
+    index += sizeof(growRequested);
+    Buffer_ReadData(buf, index, objects, objectCapacity * sizeof(Object));
+    index += objectCapacity * sizeof(Object);
+    Buffer_ReadData(buf, index, usedSlots, (objectCapacity / 64) * sizeof(Uint64));
+    index += (objectCapacity / 64) * sizeof(Uint64);
+    Buffer_ReadData(buf, index, generations, objectCapacity * sizeof(Uint16));
+    index += objectCapacity * sizeof(Uint16);
+    numDeferred = 0;
+    return index;
+}
+
+static int groupedDispatch = 0;
+
+void Object_SetGroupedDispatch(int enabled) {
+    groupedDispatch = enabled;
+}
+
+int Object_GroupedDispatch(void) {
+    return groupedDispatch;
+}
+
+#ifdef OM_OBJECT_PROFILE
+typedef struct {
+    Uint64 calls;
+    Uint64 totalNs;
+    Uint64 maxNs;
+    Uint64 sprites;
+} ObjectProfile;
+static ObjectProfile profiles[NUM_OBJECTS];
+
+static void Object_ProfileCall(Uint8 type, Object *o) {
+    int spritesBefore = Sprite_Count();
+    Uint64 start = nanotime_now();
+    objectFunctions[type](o);
+    Uint64 time = nanotime_now() - start;
+
+    ObjectProfile *profile = &profiles[type];
+    profile->calls++;
+    profile->totalNs += time;
+    profile->maxNs = MAX(profile->maxNs, time);
+    profile->sprites += Sprite_Count() - spritesBefore;
+}
+
+static int Object_CompareProfiles(const void *a, const void *b) {
+    Uint64 aTime = profiles[*(const Uint8 *)a].totalNs;
+    Uint64 bTime = profiles[*(const Uint8 *)b].totalNs;
+    if (aTime > bTime) { return -1; }
+    if (aTime < bTime) { return 1; }
+    return 0;
+}
+
+void Object_ProfileDump(void) {
+    Uint8 types[NUM_OBJECTS];
+    int count = 0;
+    for (int i = 0; i < NUM_OBJECTS; i++) {
+        if (profiles[i].calls) { types[count++] = (Uint8)i; }
+    }
+    qsort(types, count, sizeof(types[0]), Object_CompareProfiles);
+
+    printf("%-24s %10s %10s %8s %8s %10s\n", "type", "calls", "total ms", "avg ns", "max ns", "sprites");
+    for (int i = 0; i < count; i++) {
+        ObjectProfile *profile = &profiles[types[i]];
+        const char *name = objectNames[types[i]] ? objectNames[types[i]] : "?";
+        printf("%-24s %10llu %10.3f %8llu %8llu %10llu\n", name,
+               (unsigned long long)profile->calls,
+               (double)profile->totalNs / 1000000.0,
+               (unsigned long long)(profile->totalNs / profile->calls),
+               (unsigned long long)profile->maxNs,
+               (unsigned long long)profile->sprites);
+    }
+}
+
+void Object_ProfileReset(void) {
+    memset(profiles, 0, sizeof(profiles));
+}
+
+void Object_ProfileUpdate(void) {
+    static Uint8 lastF9 = 0;
+    static Uint8 lastF10 = 0;
+    // F9 = print the profile, F10 = reset it
+    if (inputState[INPUT_KEY_F9] && !lastF9) { Object_ProfileDump(); }
+    if (inputState[INPUT_KEY_F10] && !lastF10) { Object_ProfileReset(); }
+    lastF9 = inputState[INPUT_KEY_F9];
+    lastF10 = inputState[INPUT_KEY_F10];
+}
+#endif
+
+static void Object_Run(int index) {
+    Uint8 type = objects[index].type;
+    if (type) {
+        if ((type >= NUM_OBJECTS) || (objectFunctions[type] == NULL)) {
+            printf("Object 0x%X not implemented\n", type);
+            objects[index].type = OBJ_NONE;
+        }
+        else {
+#ifdef OM_OBJECT_PROFILE
+            Object_ProfileCall(type, &objects[index]);
+#else
+            objectFunctions[type](&objects[index]);
+#endif
+        }
+    }
+    // the object may have deleted itself, or been deleted by
+    // Object_DeleteRange and then respawned itself
+    if (objects[index].type) {
+        Object_MarkUsed(index);
+    }
+    else {
+        Object_MarkFree(index);
+    }
+}
+
+// Runs all the deferred objects, grouped by type. This gets run before
+// anything that looks at which slots are free, so it sees the same object
+// list as it would have if the deferred objects had run in slot order.
+static void Object_RunDeferred(void) {
+    if (!numDeferred) { return; }
+    int count = numDeferred;
+    numDeferred = 0;
+
+    // stable sort by type (the slots are already in order)
+    for (int i = 1; i < count; i++) {
+        Uint16 slot = deferredSlots[i];
+        Uint8 type = objects[slot].type;
+        int j = i;
+        while ((j > 0) && (objects[deferredSlots[j - 1]].type > type)) {
+            deferredSlots[j] = deferredSlots[j - 1];
+            j--;
+        }
+        deferredSlots[j] = slot;
+    }
+
+    int savedIndex = currObjectIndex;
+    int spriteCount = Sprite_Count();
+    for (int i = 0; i < count; i++) {
+        currObjectIndex = deferredSlots[i];
+        Object_Run(currObjectIndex);
+    }
+    currObjectIndex = savedIndex;
+    if (Sprite_Count() != spriteCount) { deferredDrew = 1; }
 }
 
 Object *Object_FindNext(int min, int max) {
-    for (int i = min; i < max; i++) {
-        if (objects[i].type == OBJ_NONE) {
-            return &objects[i];
+    Object_RunDeferred();
+    // Free slots are either gaps in the used bitmap or stale slots that got
+    // deleted since the last Object_ListRun. Walk the used slots in order so
+    // we still return the lowest numbered free slot.
+    int end = MIN(max, objectCapacity);
+    // Searches that can grow the list (custom content, -stress) skip the
+    // reserved slots. Searches within the starting list don't, because the
+    // original game let enemies take those slots and demos depend on it.
+    int skipReserved = (max > MAX_OBJECTS);
+    int i = min;
+    while (i < end) {
+        if (skipReserved && Object_IsReservedSlot(i)) {
+            i++;
+            continue;
         }
+        int used = Object_NextUsed(i);
+        // gap in the bitmap
+        if (used > i) { break; }
+        // stale slot
+        if (objects[i].type == OBJ_NONE) { break; }
+        i++;
     }
+    if (i >= end) {
+        // grow the pool at the start of the next Object_ListRun (growing now
+        // would move objects out from under the caller)
+        if ((max > objectCapacity) && (objectCapacity < OBJECT_POOL_LIMIT)) {
+            growRequested = 1;
+        }
+        return NULL;
+    }
+    Object_MarkUsed(i);
+    Object_NewGeneration(i);
+    return &objects[i];
+}
 
-    return NULL;
+Object *Object_Claim(ObjectHandle handle) {
+    assert(handle.generation == OBJECT_GENERATION_RESERVED);
+    Object_MarkUsed(handle.index);
+    Object_NewGeneration(handle.index);
+    return &objects[handle.index];
 }
 
 void Object_ListRun(void) {
-    for (currObjectIndex = 0; currObjectIndex < MAX_OBJECTS; currObjectIndex++) {
+    if (growRequested) {
+        growRequested = 0;
+        Object_Resize(MIN(objectCapacity + OBJECT_POOL_CHUNK, OBJECT_POOL_LIMIT));
+    }
+    int firstSprite = Sprite_Count();
+    deferredDrew = 0;
+
+    currObjectIndex = Object_NextUsed(0);
+    while (currObjectIndex < objectCapacity) {
         Uint8 type = objects[currObjectIndex].type;
-        if (type) {
-            if ((type >= NUM_OBJECTS) || (objectFunctions[type] == NULL)) {
-                printf("Object 0x%X not implemented\n", type);
-                objects[currObjectIndex].type = OBJ_NONE;
-            }
-            else {
-                objectFunctions[type](&objects[currObjectIndex]);
-            }
+        if (groupedDispatch && (type < NUM_OBJECTS) && objectOrderIndependent[type]) {
+            deferredSlots[numDeferred++] = currObjectIndex;
+        }
+        else {
+            Object_Run(currObjectIndex);
+        }
+        currObjectIndex = Object_NextUsed(currObjectIndex + 1);
+    }
+
+    if (groupedDispatch) {
+        Object_RunDeferred();
+        // put the sprites back in slot order so the draw order doesn't change
+        if (deferredDrew) {
+            Sprite_SortByObject(firstSprite);
         }
     }
 }
 
 void Object_DeleteRange(int start) {
-    for (int i = start; i < MAX_OBJECTS; i++) {
+    Object_RunDeferred();
+    for (int i = Object_NextUsed(start); i < objectCapacity; i = Object_NextUsed(i + 1)) {
         objects[i].type = OBJ_NONE;
+        Object_MarkFree(i);
     }
 }
 
@@ -351,20 +827,22 @@ int Object_TouchingGround(Object *o) {
         return 0;
     }
 
+    // bit 0 = previous metatile, bit 1 = current, bit 2 = next
+    Uint32 mask = 2;
     // if the object position is less than 5.5 pixels into the metatile, look at
     // the previous and current metatiles
     if (o->x.f.l < 0x58) {
-        if (Map_SolidTileBelow(o->collision - 1)) { goto foundSolidTile; }
+        mask |= 1;
     }
-
-    if (Map_SolidTileBelow(o->collision)) { goto foundSolidTile; }
-
     // if the object position is more than 10.5 pixels into the metatile, look
     // at the current and next metatiles
     if (o->x.f.l >= 0xa8) {
-        if (Map_SolidTileBelow(o->collision + 1)) { goto foundSolidTile; }
+        mask |= 4;
     }
 
+    if (Map_GetBits(MAP_PLANE_GROUND_BELOW, o->collision - 1) & mask) {
+        goto foundSolidTile;
+    }
     return 0;
 
 foundSolidTile:
@@ -419,16 +897,15 @@ int Object_PutOnGround(Object *o) {
             return 0;
         }
 
-        Uint16 metatile = Object_GetMetatile(o);
-            // if the object is in a scenery metatile and the metatile below the
-            // object is solid, we've successfully put the object on the ground
-            if (metatile >= MAP_LADDER) {
-                if (Object_GetMetatileBelow(o) < MAP_LADDER) {
-                    o->x.f.l = 0x80;
-                    o->y.f.l = 0x80;
-                    return 1;
-                }
+        // if the object is in a scenery metatile and the metatile below the
+        // object is solid, we've successfully put the object on the ground
+        if (Map_TestBit(MAP_PLANE_SCENERY, o->collision)) {
+            if (!Map_TestBit(MAP_PLANE_SCENERY, o->collision + roomWidthMetatiles)) {
+                o->x.f.l = 0x80;
+                o->y.f.l = 0x80;
+                return 1;
             }
+        }
 
         o->y.f.h++;
         Object_IncCollisionY(o);
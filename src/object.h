@@ -18,7 +18,11 @@
  */
 
 #pragma once
+#include <assert.h>
+
+#include "buffer.h"
 #include "constants.h"
+#include "map.h"
 
 // --- lucia gameplay objects ---
 #define OBJ_NONE		             (0x0)
@@ -103,7 +107,7 @@
 #define DIR_LEFT 0x80
 #define DIR_RIGHT 0
 
-typedef struct {
+typedef struct Object {
     Uint8 direction; // nonzero = facing left, zero = facing right
     Uint8 stunnedTimer;
     Sint16 hp;
@@ -116,33 +120,162 @@ typedef struct {
     Uint8 type;
 } Object;
 
+// starting size of the object list
 #define MAX_OBJECTS (256)
+// the object list grows by this many slots when it fills up...
+#define OBJECT_POOL_CHUNK (256)
+// ...up to this many slots
+#define OBJECT_POOL_LIMIT (2048)
 // object 0 = Lucia
 // objects 1-8 = Lucia's weapons
-// objects 9-MAX_OBJECTS: anything else
-extern Object objects[MAX_OBJECTS];
+// objects 9-objectCapacity: anything else
+#define OBJECT_SLOT_LUCIA (0)
+// items and fountains always go in this slot
+#define OBJECT_SLOT_ITEM (9)
+// the Wing of Madoola and Daltos always go in this slot. Slots added when
+// the list grows come after it, and Object_FindNext only hands out the
+// reserved slots when it's searching the starting MAX_OBJECTS slots (like
+// the original game did).
+#define OBJECT_SLOT_WING (MAX_OBJECTS - 1)
+// first slot for enemies and other objects that go in any free slot
+#define ENEMY_SLOT (9)
+// The object list. It can move when it grows (at the start of
+// Object_ListRun), so don't keep Object pointers across frames, use an
+// ObjectHandle instead.
+extern Object *objects;
+// number of slots in the object list
+extern int objectCapacity;
+
+// Refers to an object in a way that can tell if it's been deleted since.
+// Every time a slot gets a new object its generation is bumped, which makes
+// older handles to that slot stale.
+typedef struct {
+    Uint16 index;
+    Uint16 generation;
+} ObjectHandle;
+
+// Generation 0 is never handed out, it marks a reserved handle. Reserved
+// handles refer to whatever object is in a fixed slot.
+#define OBJECT_GENERATION_RESERVED (0)
+#define OBJECT_RESERVED_HANDLE(slot) ((ObjectHandle){ (slot), OBJECT_GENERATION_RESERVED })
+#define OBJECT_HANDLE_LUCIA OBJECT_RESERVED_HANDLE(OBJECT_SLOT_LUCIA)
+#define OBJECT_HANDLE_ITEM OBJECT_RESERVED_HANDLE(OBJECT_SLOT_ITEM)
+#define OBJECT_HANDLE_WING OBJECT_RESERVED_HANDLE(OBJECT_SLOT_WING)
 
 // The object currently being run by Object_ListRun
 extern int currObjectIndex;
 
 /**
- * @brief Clears the object list.
+ * @brief Clears the object list, and shrinks it back to its starting size if
+ * it grew.
 */
 void Object_ListInit(void);
 
+/**
+ * @param o the object
+ * @returns a handle to the object
+ */
+ObjectHandle Object_GetHandle(Object *o);
+
+/**
+ * @param handle the object's handle
+ * @returns the object, or NULL if it's been deleted or its slot has been
+ * reused. Reserved handles always return their slot's object.
+ */
+Object *Object_FromHandle(ObjectHandle handle);
+
+/**
+ * @brief Like Object_FromHandle, for objects that are expected to still be
+ * alive. Debug builds assert that the handle isn't stale, release builds
+ * don't check.
+ * @param handle the object's handle
+ * @returns the object
+ */
+Object *Object_Get(ObjectHandle handle);
+
 /**
  * @brief Gets the next free object within the specified bounds
  * @param min the low index to search from
- * @param max the high index to search from
+ * @param max the high index to search from. If this is past the end of the
+ * object list and the list is full, the list grows before the next frame.
  * @return the pointer to the found object, or NULL if there aren't any free
 */
 Object *Object_FindNext(int min, int max);
 
+/**
+ * @brief Looks up an object type by its name (for example "OBJ_NYURU_INIT" or
+ * "NYURU_INIT").
+ * @param name the object type's name
+ * @returns the object type, or -1 if there's no type with that name
+ */
+int Object_TypeFromName(const char *name);
+
+/**
+ * @brief Puts a new object in a reserved slot (instead of using
+ * Object_FindNext). Handles to the slot's previous object become stale.
+ * @param handle the reserved handle (OBJECT_HANDLE_ITEM, OBJECT_HANDLE_WING...)
+ * @returns the pointer to the object in that slot
+ */
+Object *Object_Claim(ObjectHandle handle);
+
 /**
  * @brief runs the object code for each object in the list
 */
 void Object_ListRun(void);
 
+/**
+ * @brief Adds the object list to a state snapshot
+ * @param buf buffer to add to
+ */
+void Object_SaveSnapshot(Buffer *buf);
+
+/**
+ * @brief Restores the object list from a state snapshot, resizing it if it
+ * had a different capacity when the snapshot was taken
+ * @param buf buffer to read from
+ * @param index where the object state starts in the buffer
+ * @returns the index right after the object state
+ */
+int Object_LoadSnapshot(Buffer *buf, int index);
+
+/**
+ * @brief Turns grouped object dispatch on or off. When it's on, Object_ListRun
+ * runs objects that don't depend on slot order grouped by type after the rest
+ * of the objects. The game state is the same either way.
+ * @param enabled nonzero to enable grouped dispatch, zero to use slot order
+ */
+void Object_SetGroupedDispatch(int enabled);
+
+/**
+ * @returns nonzero if grouped object dispatch is on, zero otherwise
+ */
+int Object_GroupedDispatch(void);
+
+// Per-object-type profiling (calls, time, and sprites drawn for each object
+// type). Only compiled in when OM_OBJECT_PROFILE is defined (the
+// OBJECT_PROFILE CMake option).
+#ifdef OM_OBJECT_PROFILE
+/**
+ * @brief Prints the object profile as a table, slowest object type first.
+ */
+void Object_ProfileDump(void);
+
+/**
+ * @brief Clears the object profile.
+ */
+void Object_ProfileReset(void);
+
+/**
+ * @brief Handles the profiling hotkeys (F9 prints, F10 resets). Should be run
+ * once per frame.
+ */
+void Object_ProfileUpdate(void);
+#else
+#define Object_ProfileDump() ((void)0)
+#define Object_ProfileReset() ((void)0)
+#define Object_ProfileUpdate() ((void)0)
+#endif
+
 /**
  * @brief Deletes the given index and all objects after it.
  * @param start The index to start deletion at
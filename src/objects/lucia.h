@@ -26,6 +26,7 @@ extern Uint8 bootsLevel;
 extern Uint8 attackTimer;
 extern Uint8 hasWing;
 extern Uint8 usingWing;
+extern Uint8 luciaDoorFlag;
 extern Uint8 luciaHurtPoints;
 
 extern Sint16 health;
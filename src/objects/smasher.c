@@ -38,7 +38,7 @@ static Uint8 smasherDelays[] = {
 };
 
 static int Smasher_FindEnemy(void) {
-    for (int i = 9; i < MAX_OBJECTS; i++) {
+    for (int i = 9; i < objectCapacity; i++) {
         if (objects[i].type) {
             return i;
         }
@@ -156,6 +156,8 @@ static int ntscCB(int num) {
     return Platform_SetNTSC(num);
 }
 
+static char *audioLatencyOptions[] = {"Normal", "Low 512", "Low 384", "Low 256"};
+
 static void keyboardTask(void) {
     mapType = KEYBOARD_CONTROLS;
     Menu_Run(12, 24, 2, controlsItems, ARRAY_LEN(controlsItems), controlsDraw);
@@ -230,6 +232,7 @@ static MenuItem optionsItems[] = {
     MENU_LIST("Overscan", boolOptions, Platform_GetOverscan, overscanCB),
     MENU_LIST("NTSC filter", boolOptions, Platform_GetNTSC, ntscCB),
     MENU_NUM("Volume", Sound_GetVolume, Sound_SetVolume, 5),
+    MENU_LIST("Audio latency", audioLatencyOptions, Platform_GetAudioLatency, Platform_SetAudioLatency),
     MENU_TASK("Keyboard controls", keyboardTask),
     MENU_TASK("Gamepad controls", gamepadTask),
     MENU_LIST("Game type", gameTypeOptions, gameTypeInit, gameTypeCB),
@@ -246,5 +249,5 @@ void Options_Draw(void) {
 void Options_Run(void) {
     BG_SetAllPalettes(palette);
     Sprite_SetAllPalettes(palette + 16);
-    Menu_Run(3, 5, 2, optionsItems, ARRAY_LEN(optionsItems), Options_Draw);
+    Menu_Run(3, 4, 2, optionsItems, ARRAY_LEN(optionsItems), Options_Draw);
 }
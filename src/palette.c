@@ -42,3 +42,15 @@ Uint8 *Palette_Run(void) {
     }
     return colorPalette;
 }
+
+void Palette_SaveSnapshot(Buffer *buf) {
+    Buffer_AddData(buf, colorPalette, sizeof(colorPalette));
+    Buffer_AddData(buf, &flashTimer, sizeof(flashTimer));
+}
+
+int Palette_LoadSnapshot(Buffer *buf, int index) {
+    Buffer_ReadData(buf, index, colorPalette, sizeof(colorPalette));
+    index += sizeof(colorPalette);
+    flashTimer = buf->data[index++];
+    return index;
+}
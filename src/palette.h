@@ -18,6 +18,7 @@
  */
 
 #pragma once
+#include "buffer.h"
 #include "constants.h"
 #include "graphics.h"
 
@@ -31,3 +32,17 @@ extern Uint8 flashTimer;
  * if flashTimer is nonzero, otherwise the standard palette)
 */
 Uint8 *Palette_Run(void);
+
+/**
+ * @brief Adds the color palette and flash timer to a state snapshot
+ * @param buf buffer to add to
+ */
+void Palette_SaveSnapshot(Buffer *buf);
+
+/**
+ * @brief Restores the color palette and flash timer from a state snapshot
+ * @param buf buffer to read from
+ * @param index where the palette state starts in the buffer
+ * @returns the index right after the palette state
+ */
+int Palette_LoadSnapshot(Buffer *buf, int index);
@@ -42,15 +42,63 @@ __attribute__((__format__(__printf__, 1, 2)))
 void Platform_ShowError(const char *fmt, ...);
 
 /**
- * @brief Should be run at the start of each frame.
+ * @brief Should be run at the start of each frame. Waits until it's time for
+ * the frame to start, then reads input.
  */
 void Platform_StartFrame(void);
 
 /**
- * @brief Should be run at the end of each frame.
+ * @brief Should be run at the end of each frame. Presents the frame.
  */
 void Platform_EndFrame(void);
 
+/**
+ * @brief Turns just-in-time frame starts on or off. With vsync, each frame
+ * starts as late as the measured frame time allows, instead of right after
+ * the previous frame was presented.
+ * @param requested 1 to turn JIT mode on, 0 to turn it off
+ * @returns the set JIT mode
+ */
+int Platform_SetJIT(int requested);
+
+/**
+ * @returns 1 if JIT mode is on, 0 if it's off
+ */
+int Platform_GetJIT(void);
+
+/**
+ * @brief Prints the measured time between reading input and presenting the
+ * frame that used it.
+ */
+void Platform_PrintLatency(void);
+
+/**
+ * @brief Turns auto frameskip on or off. When it's on and the game is running
+ * behind, frames get skipped (not drawn or presented, up to 3 in a row) so
+ * the game and sound keep running at full speed.
+ * @param requested 1 to turn auto frameskip on, 0 to turn it off
+ * @returns the set frameskip mode
+ */
+int Platform_SetFrameskip(int requested);
+
+/**
+ * @returns 1 if auto frameskip is on, 0 if it's off
+ */
+int Platform_GetFrameskip(void);
+
+/**
+ * @brief Temporarily stops auto frameskip from skipping any frames, without
+ * changing (or saving) the frameskip setting.
+ * @param suspend 1 to stop skipping frames, 0 to go back to the setting
+ */
+void Platform_SuspendFrameskip(int suspend);
+
+/**
+ * @returns 1 if the current frame is being skipped (it won't be presented, so
+ * it doesn't need to be drawn)
+ */
+int Platform_SkippingFrame(void);
+
 /**
  * @brief Gets access to the framebuffer.
  * @returns a pointer to the NES framebuffer pixels (NES 6-bit).
@@ -136,6 +184,53 @@ int Platform_GetArcadeColor(void);
  */
 int Platform_SetArcadeColor(int requested);
 
+// audio latency settings
+typedef enum {
+    // the game pushes audio to a queue every frame
+    AUDIO_LATENCY_NORMAL,
+    // the audio device pulls audio straight from the sound engine with a
+    // callback, with a buffer of 512, 384, or 256 frames
+    AUDIO_LATENCY_LOW_512,
+    AUDIO_LATENCY_LOW_384,
+    AUDIO_LATENCY_LOW_256,
+    NUM_AUDIO_LATENCIES,
+} AUDIO_LATENCY;
+
+/**
+ * @brief Sets the audio latency mode, reopening the audio device.
+ * @param requested AUDIO_LATENCY value
+ * @returns the set audio latency mode
+ */
+int Platform_SetAudioLatency(int requested);
+
+/**
+ * @returns the current audio latency mode (see AUDIO_LATENCY)
+ */
+int Platform_GetAudioLatency(void);
+
+/**
+ * @returns the achieved audio output latency in milliseconds (how much audio
+ * is buffered between the sound engine and the speakers)
+ */
+double Platform_GetAudioLatencyMs(void);
+
+/**
+ * @brief Blocks the audio device's callback from running. The sound engine
+ * needs to do this before changing anything the callback reads.
+ */
+void Platform_LockAudio(void);
+
+/**
+ * @brief Undoes Platform_LockAudio.
+ */
+void Platform_UnlockAudio(void);
+
+/**
+ * @returns the audio output sample rate (the audio device's native rate when
+ * possible, so the audio doesn't get resampled on its way out)
+ */
+int Platform_GetSampleRate(void);
+
 /**
  * @brief Queues the given audio samples to play
  * @param samples The buffer of samples to queue
@@ -30,6 +30,7 @@
 #include "nanotime.h"
 #include "nes_ntsc.h"
 #include "platform.h"
+#include "sound.h"
 #include "util.h"
 
 // --- video stuff ---
@@ -57,11 +58,52 @@ static SDL_Rect overscanSrcRect = {
 static SDL_Texture *scaleTexture = NULL;
 static int vsync;
 static nanotime_step_data stepData;
+// when set, each frame starts as late as the measured frame time allows, so
+// input gets read as close to presenting as possible (only with vsync)
+static Uint8 jitEnabled = 0;
+#define NSEC_PER_MSEC (1000000)
+// how long before the next vblank to aim for finishing the frame in JIT mode
+#define JIT_MARGIN_NS (2 * NSEC_PER_MSEC)
+// how long the last several frames took from reading input to being ready to
+// present
+#define FRAME_TIME_HISTORY 30
+static Uint64 frameTimes[FRAME_TIME_HISTORY];
+static int frameTimeIndex;
+// when input was read for the current frame
+static Uint64 latchNs;
+// when the previous frame finished presenting
+static Uint64 presentNs;
+// input to present latency stats
+static Uint64 latencyTotalNs;
+static Uint64 latencyMaxNs;
+static Uint32 latencyFrames;
+// when set, frames don't get drawn or presented while the game is running
+// behind, so the game logic and sound can catch up
+static Uint8 frameskipEnabled = 0;
+// turns frameskip off without changing the setting
+static Uint8 frameskipSuspended = 0;
+// most frames in a row that can be skipped
+#define MAX_FRAMESKIP 3
+#define FRAME_NS (NANOTIME_NSEC_PER_SEC / 60)
+static int skippedFrames;
+static Uint8 skipFrame;
+// when the previous frame started
+static Uint64 frameStartNs;
+// average time spent drawing the framebuffer to the screen
+static Uint64 renderCostNs;
 static nes_ntsc_t ntsc;
 static Uint8 ntscEnabled = 0;
 
 // --- audio stuff ---
 static SDL_AudioDeviceID audioDevice;
+static Uint8 audioLatency = AUDIO_LATENCY_NORMAL;
+// device buffer size in low latency mode
+static const int lowLatencyFrames[] = {
+    [AUDIO_LATENCY_LOW_512] = 512,
+    [AUDIO_LATENCY_LOW_384] = 384,
+    [AUDIO_LATENCY_LOW_256] = 256,
+};
+static double audioLatencyMs;
 
 // --- palette stuff ---
 #define NUM_COLORS 64
@@ -93,6 +135,13 @@ static const int gamepadMap[] = {
     [SDL_CONTROLLER_BUTTON_DPAD_RIGHT] = INPUT_GAMEPAD_DPAD_RIGHT,
     [SDL_CONTROLLER_BUTTON_MAX] = INPUT_INVALID,
 };
+// SDL reports the triggers as axes, so they count as pressed past halfway
+static const int triggerMap[] = {
+    [SDL_CONTROLLER_AXIS_TRIGGERLEFT] = INPUT_GAMEPAD_L_TRIGGER,
+    [SDL_CONTROLLER_AXIS_TRIGGERRIGHT] = INPUT_GAMEPAD_R_TRIGGER,
+    [SDL_CONTROLLER_AXIS_MAX] = INPUT_INVALID,
+};
+#define TRIGGER_THRESHOLD (SDL_JOYSTICK_AXIS_MAX / 2)
 static SDL_GameController *controller;
 
 // static function declarations
@@ -225,11 +274,65 @@ static void Platform_ResizeWindow(void) {
     }
 }
 
+// Waits until it's time to start the next frame. The wait happens before
+// reading input instead of after rendering, so the input is as fresh as
+// possible when the frame gets presented. Returns 1 if the game is running
+// behind.
+static int Platform_WaitForFrame(void) {
+    // monitor framerate isn't a multiple of 60, so wait in software
+    if (!vsync) {
+        // doesn't sleep if we're behind
+        return !nanotime_step(&stepData);
+    }
+    // presenting waits for the next vblank, so in JIT mode, start the frame
+    // late enough that it's done just before then
+    else if (jitEnabled) {
+        Uint64 longest = 0;
+        for (int i = 0; i < FRAME_TIME_HISTORY; i++) {
+            longest = MAX(longest, frameTimes[i]);
+        }
+        Uint64 refreshNs = NANOTIME_NSEC_PER_SEC / (60 * vsync);
+        Uint64 neededNs = longest + JIT_MARGIN_NS;
+        if (neededNs < refreshNs) {
+            Uint64 startNs = presentNs + (refreshNs - neededNs);
+            Uint64 now = nanotime_now();
+            if (now < startNs) {
+                nanotime_sleep(startNs - now);
+            }
+        }
+    }
+    return 0;
+}
+
+static void Platform_UpdateFrameskip(int behind) {
+    // skipping frames only helps if drawing them takes a good chunk of the
+    // frame time
+    if (frameskipEnabled && !frameskipSuspended && behind && (renderCostNs > (FRAME_NS / 4)) &&
+        (skippedFrames < MAX_FRAMESKIP))
+    {
+        skipFrame = 1;
+        skippedFrames++;
+    }
+    else {
+        skipFrame = 0;
+        skippedFrames = 0;
+    }
+}
+
 void Platform_StartFrame(void) {
     if (frameStarted) {
         printf("ERROR: Started frame without ending the previous frame!\n");
     }
     frameStarted = 1;
+    int behind = Platform_WaitForFrame();
+    Uint64 now = nanotime_now();
+    // with vsync, a frame that took more than 1.5 frame times missed a vblank
+    if (vsync && frameStartNs && ((now - frameStartNs) > (FRAME_NS * 3 / 2))) {
+        behind = 1;
+    }
+    frameStartNs = now;
+    Platform_UpdateFrameskip(behind);
+    latchNs = now;
     Platform_PumpEvents();
 }
 
@@ -240,6 +343,9 @@ void Platform_EndFrame(void) {
         printf("ERROR: Ended frame without starting it!\n");
     }
     frameStarted = 0;
+    if (skipFrame) { return; }
+
+    Uint64 renderStart = nanotime_now();
     // convert framebuffer from nes colors to rgb
     Uint32 *rgbFramebuffer;
     int pitch;
@@ -284,10 +390,9 @@ void Platform_EndFrame(void) {
     SDL_RenderCopy(renderer, drawTexture, overscan ? &overscanSrcRect : NULL, NULL);
     SDL_SetRenderTarget(renderer, NULL);
 
-    // monitor framerate isn't a multiple of 60, so wait in software
-    if (!vsync) {
-        nanotime_step(&stepData);
-    }
+    Uint64 renderEnd = nanotime_now();
+    frameTimes[frameTimeIndex] = renderEnd - latchNs;
+    frameTimeIndex = (frameTimeIndex + 1) % FRAME_TIME_HISTORY;
 
     for (int i = 0; i < (vsync ? vsync : 1); i++) {
         SDL_RenderClear(renderer);
@@ -298,7 +403,64 @@ void Platform_EndFrame(void) {
             SDL_RenderCopy(renderer, scaleTexture, NULL, NULL);
         }
         SDL_RenderPresent(renderer);
+        // the frame is on screen after the first present
+        if (i == 0) {
+            // with vsync, presenting waits for the vblank, so don't count it
+            if (!vsync) {
+                renderEnd = nanotime_now();
+            }
+            renderCostNs = ((renderCostNs * 7) + (renderEnd - renderStart)) / 8;
+            // SDL event timestamps use SDL's millisecond tick clock
+            Input_FramePresented((Uint64)SDL_GetTicks() * 1000000);
+            Uint64 latency = nanotime_now() - latchNs;
+            latencyTotalNs += latency;
+            latencyMaxNs = MAX(latencyMaxNs, latency);
+            latencyFrames++;
+        }
+    }
+    presentNs = nanotime_now();
+}
+
+int Platform_SetJIT(int requested) {
+    if (requested != jitEnabled) {
+        jitEnabled = (Uint8)requested;
+        DB_Set("jit", &jitEnabled, 1);
+        DB_Save();
     }
+    return jitEnabled;
+}
+
+int Platform_GetJIT(void) {
+    return jitEnabled;
+}
+
+int Platform_SetFrameskip(int requested) {
+    if (requested != frameskipEnabled) {
+        frameskipEnabled = (Uint8)requested;
+        DB_Set("frameskip", &frameskipEnabled, 1);
+        DB_Save();
+    }
+    return frameskipEnabled;
+}
+
+int Platform_GetFrameskip(void) {
+    return frameskipEnabled;
+}
+
+void Platform_SuspendFrameskip(int suspend) {
+    frameskipSuspended = (Uint8)suspend;
+}
+
+int Platform_SkippingFrame(void) {
+    return skipFrame;
+}
+
+void Platform_PrintLatency(void) {
+    if (!latencyFrames) { return; }
+    printf("Input to present latency: avg %.2f ms, max %.2f ms (%u frames)\n",
+           (double)latencyTotalNs / latencyFrames / NSEC_PER_MSEC,
+           (double)latencyMaxNs / NSEC_PER_MSEC,
+           latencyFrames);
 }
 
 void Platform_ShowError(const char *fmt, ...) {
@@ -409,19 +571,53 @@ int Platform_SetArcadeColor(int requested) {
     return arcadeColor;
 }
 
+// target queue size at 44.1khz, gets scaled to the actual sample rate
 #define TARGET_SAMPLES 1024
+#define DEFAULT_SAMPLE_RATE 44100
+static int sampleRate;
+static int targetSamples;
+
+// low latency mode: the audio device asks for samples when it needs them
+static void SDLCALL Platform_AudioCallback(void *userdata, Uint8 *stream, int len) {
+    (void)userdata;
+    Sound_FillBuffer((Sint16 *)stream, len / sizeof(Sint16));
+}
 
 static int Platform_InitAudio(void) {
     SDL_AudioSpec spec = { 0 };
-    spec.freq = 44100;
+    SDL_AudioSpec obtained;
+    // the sound engine only gets the sample rate once (in Sound_Init), so when
+    // the device gets reopened, keep the rate it's already running at
+    spec.freq = sampleRate ? sampleRate : DEFAULT_SAMPLE_RATE;
     spec.format = AUDIO_S16;
     spec.channels = 1;
-    spec.samples = TARGET_SAMPLES;
-    audioDevice = SDL_OpenAudioDevice(NULL, 0, &spec, NULL, 0);
+    if (audioLatency == AUDIO_LATENCY_NORMAL) {
+        spec.samples = TARGET_SAMPLES;
+    }
+    else {
+        spec.samples = lowLatencyFrames[audioLatency];
+        spec.callback = Platform_AudioCallback;
+    }
+    // the first time, let SDL pick the device's native sample rate so it doesn't have to resample
+    int allowedChanges = SDL_AUDIO_ALLOW_SAMPLES_CHANGE;
+    if (!sampleRate) { allowedChanges |= SDL_AUDIO_ALLOW_FREQUENCY_CHANGE; }
+    audioDevice = SDL_OpenAudioDevice(NULL, 0, &spec, &obtained, allowedChanges);
     if (!audioDevice) {
         Platform_ShowError("Error creating audioDevice: %s", SDL_GetError());
         return 0;
     }
+    sampleRate = obtained.freq;
+    targetSamples = (int)((Sint64)TARGET_SAMPLES * sampleRate / DEFAULT_SAMPLE_RATE);
+
+    // the device may not give us the buffer size we asked for, so report what we actually got
+    int latencyFrames = obtained.samples;
+    if (audioLatency == AUDIO_LATENCY_NORMAL) {
+        latencyFrames += targetSamples;
+    }
+    audioLatencyMs = (double)latencyFrames * 1000 / sampleRate;
+    printf("Audio: %d Hz, %s mode, %d frame device buffer, ~%.1f ms latency\n",
+           sampleRate, (audioLatency == AUDIO_LATENCY_NORMAL) ? "push" : "callback",
+           obtained.samples, audioLatencyMs);
     SDL_PauseAudioDevice(audioDevice, 0);
     return 1;
 }
@@ -430,6 +626,38 @@ static void Platform_DestroyAudio(void) {
     SDL_CloseAudioDevice(audioDevice);
 }
 
+int Platform_SetAudioLatency(int requested) {
+    if (requested < 0) { requested = NUM_AUDIO_LATENCIES - 1; }
+    if (requested >= NUM_AUDIO_LATENCIES) { requested = AUDIO_LATENCY_NORMAL; }
+    if (requested != audioLatency) {
+        Platform_DestroyAudio();
+        audioLatency = (Uint8)requested;
+        if (!Platform_InitAudio()) {
+            audioLatency = AUDIO_LATENCY_NORMAL;
+            Platform_InitAudio();
+        }
+        DB_Set("audioLatency", &audioLatency, 1);
+        DB_Save();
+    }
+    return audioLatency;
+}
+
+int Platform_GetAudioLatency(void) {
+    return audioLatency;
+}
+
+double Platform_GetAudioLatencyMs(void) {
+    return audioLatencyMs;
+}
+
+void Platform_LockAudio(void) {
+    SDL_LockAudioDevice(audioDevice);
+}
+
+void Platform_UnlockAudio(void) {
+    SDL_UnlockAudioDevice(audioDevice);
+}
+
 void Platform_QueueSamples(Sint16 *samples, int count) {
     SDL_QueueAudio(audioDevice, (void *)samples, count * sizeof(Sint16));
 }
@@ -439,7 +667,11 @@ int Platform_GetQueuedSamples(void) {
 }
 
 int Platform_GetTargetSamples(void) {
-    return TARGET_SAMPLES;
+    return targetSamples;
+}
+
+int Platform_GetSampleRate(void) {
+    return sampleRate;
 }
 
 int Platform_GamepadConnected(void) {
@@ -560,6 +792,12 @@ int Platform_Init(void) {
     if (entry) { overscan = entry->data[0]; }
     entry = DB_Find("arcadeColor");
     if (entry) { arcadeColor = entry->data[0]; }
+    entry = DB_Find("jit");
+    if (entry) { jitEnabled = entry->data[0]; }
+    entry = DB_Find("frameskip");
+    if (entry) { frameskipEnabled = entry->data[0]; }
+    entry = DB_Find("audioLatency");
+    if (entry && (entry->data[0] < NUM_AUDIO_LATENCIES)) { audioLatency = entry->data[0]; }
 
     if (!Platform_InitPalettes()) { return 0; }
     Platform_InitNTSC();
@@ -600,7 +838,7 @@ static void Platform_PumpEvents(void) {
                 button = (button - SDL_SCANCODE_LCTRL) + INPUT_KEY_LCTRL;
             }
             if ((button >= INPUT_KEY_A) && (button <= INPUT_KEY_RGUI)) {
-                Input_SetState(button, event.type == SDL_KEYDOWN);
+                Input_SetState(button, event.type == SDL_KEYDOWN, (Uint64)event.key.timestamp * 1000000);
             }
             break;
 
@@ -619,7 +857,16 @@ static void Platform_PumpEvents(void) {
                 // match the button to the enum in input.h
                 button = gamepadMap[event.cbutton.button];
                 if (button != INPUT_INVALID) {
-                    Input_SetState(button, event.type == SDL_CONTROLLERBUTTONDOWN);
+                    Input_SetState(button, event.type == SDL_CONTROLLERBUTTONDOWN, (Uint64)event.cbutton.timestamp * 1000000);
+                }
+            }
+            break;
+
+        case SDL_CONTROLLERAXISMOTION:
+            if (event.caxis.axis < ARRAY_LEN(triggerMap)) {
+                button = triggerMap[event.caxis.axis];
+                if (button != INPUT_INVALID) {
+                    Input_SetState(button, event.caxis.value > TRIGGER_THRESHOLD, (Uint64)event.caxis.timestamp * 1000000);
                 }
             }
             break;
@@ -32,6 +32,7 @@
 #include "nes_ntsc.h"
 #include "palette.h"
 #include "platform.h"
+#include "sound.h"
 #include "util.h"
 
 // --- video stuff ---
@@ -60,12 +61,53 @@ static SDL_FRect overscanSrcRect = {
 static SDL_Texture *scaleTexture = NULL;
 static int vsync;
 static nanotime_step_data stepData;
+// when set, each frame starts as late as the measured frame time allows, so
+// input gets read as close to presenting as possible (only with vsync)
+static Uint8 jitEnabled = 0;
+#define NSEC_PER_MSEC (1000000)
+// how long before the next vblank to aim for finishing the frame in JIT mode
+#define JIT_MARGIN_NS (2 * NSEC_PER_MSEC)
+// how long the last several frames took from reading input to being ready to
+// present
+#define FRAME_TIME_HISTORY 30
+static Uint64 frameTimes[FRAME_TIME_HISTORY];
+static int frameTimeIndex;
+// when input was read for the current frame
+static Uint64 latchNs;
+// when the previous frame finished presenting
+static Uint64 presentNs;
+// input to present latency stats
+static Uint64 latencyTotalNs;
+static Uint64 latencyMaxNs;
+static Uint32 latencyFrames;
+// when set, frames don't get drawn or presented while the game is running
+// behind, so the game logic and sound can catch up
+static Uint8 frameskipEnabled = 0;
+// turns frameskip off without changing the setting
+static Uint8 frameskipSuspended = 0;
+// most frames in a row that can be skipped
+#define MAX_FRAMESKIP 3
+#define FRAME_NS (NANOTIME_NSEC_PER_SEC / 60)
+static int skippedFrames;
+static Uint8 skipFrame;
+// when the previous frame started
+static Uint64 frameStartNs;
+// average time spent drawing the framebuffer to the screen
+static Uint64 renderCostNs;
 static nes_ntsc_t ntsc;
 static nes_ntsc_setup_t ntscSetup;
 static Uint8 ntscEnabled;
 
 // --- audio stuff ---
 static SDL_AudioStream *audioStream;
+static Uint8 audioLatency = AUDIO_LATENCY_NORMAL;
+// device buffer size in low latency mode
+static const int lowLatencyFrames[] = {
+    [AUDIO_LATENCY_LOW_512] = 512,
+    [AUDIO_LATENCY_LOW_384] = 384,
+    [AUDIO_LATENCY_LOW_256] = 256,
+};
+static double audioLatencyMs;
 
 // --- palette stuff ---
 #define NUM_COLORS 64
@@ -97,6 +139,13 @@ static const int gamepadMap[] = {
     [SDL_GAMEPAD_BUTTON_DPAD_RIGHT] = INPUT_GAMEPAD_DPAD_RIGHT,
     [SDL_GAMEPAD_BUTTON_COUNT] = INPUT_INVALID,
 };
+// SDL reports the triggers as axes, so they count as pressed past halfway
+static const int triggerMap[] = {
+    [SDL_GAMEPAD_AXIS_LEFT_TRIGGER] = INPUT_GAMEPAD_L_TRIGGER,
+    [SDL_GAMEPAD_AXIS_RIGHT_TRIGGER] = INPUT_GAMEPAD_R_TRIGGER,
+    [SDL_GAMEPAD_AXIS_COUNT] = INPUT_INVALID,
+};
+#define TRIGGER_THRESHOLD (SDL_JOYSTICK_AXIS_MAX / 2)
 static SDL_Gamepad *gamepad;
 
 // static function declarations
@@ -244,11 +293,65 @@ static void Platform_ResizeWindow(void) {
     }
 }
 
+// Waits until it's time to start the next frame. The wait happens before
+// reading input instead of after rendering, so the input is as fresh as
+// possible when the frame gets presented. Returns 1 if the game is running
+// behind.
+static int Platform_WaitForFrame(void) {
+    // monitor framerate isn't a multiple of 60, so wait in software
+    if (!vsync) {
+        // doesn't sleep if we're behind
+        return !nanotime_step(&stepData);
+    }
+    // presenting waits for the next vblank, so in JIT mode, start the frame
+    // late enough that it's done just before then
+    else if (jitEnabled) {
+        Uint64 longest = 0;
+        for (int i = 0; i < FRAME_TIME_HISTORY; i++) {
+            longest = MAX(longest, frameTimes[i]);
+        }
+        Uint64 refreshNs = NANOTIME_NSEC_PER_SEC / (60 * vsync);
+        Uint64 neededNs = longest + JIT_MARGIN_NS;
+        if (neededNs < refreshNs) {
+            Uint64 startNs = presentNs + (refreshNs - neededNs);
+            Uint64 now = nanotime_now();
+            if (now < startNs) {
+                nanotime_sleep(startNs - now);
+            }
+        }
+    }
+    return 0;
+}
+
+static void Platform_UpdateFrameskip(int behind) {
+    // skipping frames only helps if drawing them takes a good chunk of the
+    // frame time
+    if (frameskipEnabled && !frameskipSuspended && behind && (renderCostNs > (FRAME_NS / 4)) &&
+        (skippedFrames < MAX_FRAMESKIP))
+    {
+        skipFrame = 1;
+        skippedFrames++;
+    }
+    else {
+        skipFrame = 0;
+        skippedFrames = 0;
+    }
+}
+
 void Platform_StartFrame(void) {
     if (frameStarted) {
         printf("ERROR: Started frame without ending the previous frame!\n");
     }
     frameStarted = 1;
+    int behind = Platform_WaitForFrame();
+    Uint64 now = nanotime_now();
+    // with vsync, a frame that took more than 1.5 frame times missed a vblank
+    if (vsync && frameStartNs && ((now - frameStartNs) > (FRAME_NS * 3 / 2))) {
+        behind = 1;
+    }
+    frameStartNs = now;
+    Platform_UpdateFrameskip(behind);
+    latchNs = now;
     Platform_PumpEvents();
 }
 
@@ -259,6 +362,9 @@ void Platform_EndFrame(void) {
         printf("ERROR: Ended frame without starting it!\n");
     }
     frameStarted = 0;
+    if (skipFrame) { return; }
+
+    Uint64 renderStart = nanotime_now();
     // convert framebuffer from nes colors to rgb
     Uint32 *rgbFramebuffer = NULL;
     int pitch;
@@ -304,10 +410,9 @@ void Platform_EndFrame(void) {
     SDL_RenderTexture(renderer, drawTexture, overscan ? &overscanSrcRect : NULL, NULL);
     SDL_SetRenderTarget(renderer, NULL);
 
-    // monitor framerate isn't a multiple of 60, so wait in software
-    if (!vsync) {
-        nanotime_step(&stepData);
-    }
+    Uint64 renderEnd = nanotime_now();
+    frameTimes[frameTimeIndex] = renderEnd - latchNs;
+    frameTimeIndex = (frameTimeIndex + 1) % FRAME_TIME_HISTORY;
 
     for (int i = 0; i < (vsync ? vsync : 1); i++) {
         SDL_RenderClear(renderer);
@@ -318,7 +423,64 @@ void Platform_EndFrame(void) {
             SDL_RenderTexture(renderer, scaleTexture, NULL, NULL);
         }
         SDL_RenderPresent(renderer);
+        // the frame is on screen after the first present
+        if (i == 0) {
+            // with vsync, presenting waits for the vblank, so don't count it
+            if (!vsync) {
+                renderEnd = nanotime_now();
+            }
+            renderCostNs = ((renderCostNs * 7) + (renderEnd - renderStart)) / 8;
+            // SDL event timestamps use SDL's tick clock
+            Input_FramePresented(SDL_GetTicksNS());
+            Uint64 latency = nanotime_now() - latchNs;
+            latencyTotalNs += latency;
+            latencyMaxNs = MAX(latencyMaxNs, latency);
+            latencyFrames++;
+        }
+    }
+    presentNs = nanotime_now();
+}
+
+int Platform_SetJIT(int requested) {
+    if (requested != jitEnabled) {
+        jitEnabled = (Uint8)requested;
+        DB_Set("jit", &jitEnabled, 1);
+        DB_Save();
+    }
+    return jitEnabled;
+}
+
+int Platform_GetJIT(void) {
+    return jitEnabled;
+}
+
+int Platform_SetFrameskip(int requested) {
+    if (requested != frameskipEnabled) {
+        frameskipEnabled = (Uint8)requested;
+        DB_Set("frameskip", &frameskipEnabled, 1);
+        DB_Save();
     }
+    return frameskipEnabled;
+}
+
+int Platform_GetFrameskip(void) {
+    return frameskipEnabled;
+}
+
+void Platform_SuspendFrameskip(int suspend) {
+    frameskipSuspended = (Uint8)suspend;
+}
+
+int Platform_SkippingFrame(void) {
+    return skipFrame;
+}
+
+void Platform_PrintLatency(void) {
+    if (!latencyFrames) { return; }
+    printf("Input to present latency: avg %.2f ms, max %.2f ms (%u frames)\n",
+           (double)latencyTotalNs / latencyFrames / NSEC_PER_MSEC,
+           (double)latencyMaxNs / NSEC_PER_MSEC,
+           latencyFrames);
 }
 
 void Platform_ShowError(const char *fmt, ...) {
@@ -430,19 +592,70 @@ int Platform_SetArcadeColor(int requested) {
     return arcadeColor;
 }
 
+// target queue size at 44.1khz, gets scaled to the actual sample rate
 #define TARGET_SAMPLES 1024
+#define DEFAULT_SAMPLE_RATE 44100
+static int sampleRate;
+static int targetSamples;
+
+// low latency mode: the audio device asks for samples when it needs them
+static void SDLCALL Platform_AudioCallback(void *userdata, SDL_AudioStream *stream, int additionalAmount, int totalAmount) {
+    (void)userdata;
+    (void)totalAmount;
+    Sint16 buff[512];
+    int count = additionalAmount / sizeof(Sint16);
+    while (count > 0) {
+        int chunk = (count < ARRAY_LEN(buff)) ? count : ARRAY_LEN(buff);
+        Sound_FillBuffer(buff, chunk);
+        SDL_PutAudioStreamData(stream, buff, chunk * sizeof(Sint16));
+        count -= chunk;
+    }
+}
 
 static int Platform_InitAudio(void) {
-    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, OM_TOSTR(TARGET_SAMPLES));
+    // run at the device's native sample rate so SDL doesn't have to resample.
+    // the sound engine only gets the sample rate once (in Sound_Init), so when
+    // the device gets reopened, keep the rate it's already running at
     SDL_AudioSpec spec = { 0 };
-    spec.freq = 44100;
+    int deviceFrames;
+    if (sampleRate) {
+        spec.freq = sampleRate;
+    }
+    else if (!SDL_GetAudioDeviceFormat(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, &deviceFrames) || (spec.freq <= 0)) {
+        spec.freq = DEFAULT_SAMPLE_RATE;
+    }
+    sampleRate = spec.freq;
+    targetSamples = (int)((Sint64)TARGET_SAMPLES * sampleRate / DEFAULT_SAMPLE_RATE);
+    char hint[16];
+    if (audioLatency == AUDIO_LATENCY_NORMAL) {
+        SDL_snprintf(hint, sizeof(hint), "%d", targetSamples);
+    }
+    else {
+        SDL_snprintf(hint, sizeof(hint), "%d", lowLatencyFrames[audioLatency]);
+    }
+    SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, hint);
+
     spec.format = SDL_AUDIO_S16;
     spec.channels = 1;
-    audioStream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, NULL, NULL);
+    SDL_AudioStreamCallback callback = (audioLatency == AUDIO_LATENCY_NORMAL) ? NULL : Platform_AudioCallback;
+    audioStream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, callback, NULL);
     if (!audioStream) {
         Platform_ShowError("Error creating audioStream: %s", SDL_GetError());
         return 0;
     }
+
+    // the device may not give us the buffer size we asked for, so report what we actually got
+    if (!SDL_GetAudioDeviceFormat(SDL_GetAudioStreamDevice(audioStream), NULL, &deviceFrames)) {
+        deviceFrames = 0;
+    }
+    int latencyFrames = deviceFrames;
+    if (audioLatency == AUDIO_LATENCY_NORMAL) {
+        latencyFrames += targetSamples;
+    }
+    audioLatencyMs = (double)latencyFrames * 1000 / sampleRate;
+    printf("Audio: %d Hz, %s mode, %d frame device buffer, ~%.1f ms latency\n",
+           sampleRate, (audioLatency == AUDIO_LATENCY_NORMAL) ? "push" : "callback",
+           deviceFrames, audioLatencyMs);
     SDL_ResumeAudioDevice(SDL_GetAudioStreamDevice(audioStream));
     return 1;
 }
@@ -451,6 +664,38 @@ static void Platform_DestroyAudio(void) {
     SDL_DestroyAudioStream(audioStream);
 }
 
+int Platform_SetAudioLatency(int requested) {
+    if (requested < 0) { requested = NUM_AUDIO_LATENCIES - 1; }
+    if (requested >= NUM_AUDIO_LATENCIES) { requested = AUDIO_LATENCY_NORMAL; }
+    if (requested != audioLatency) {
+        Platform_DestroyAudio();
+        audioLatency = (Uint8)requested;
+        if (!Platform_InitAudio()) {
+            audioLatency = AUDIO_LATENCY_NORMAL;
+            Platform_InitAudio();
+        }
+        DB_Set("audioLatency", &audioLatency, 1);
+        DB_Save();
+    }
+    return audioLatency;
+}
+
+int Platform_GetAudioLatency(void) {
+    return audioLatency;
+}
+
+double Platform_GetAudioLatencyMs(void) {
+    return audioLatencyMs;
+}
+
+void Platform_LockAudio(void) {
+    SDL_LockAudioStream(audioStream);
+}
+
+void Platform_UnlockAudio(void) {
+    SDL_UnlockAudioStream(audioStream);
+}
+
 void Platform_QueueSamples(Sint16 *samples, int count) {
     SDL_PutAudioStreamData(audioStream, (void *)samples, count * sizeof(Sint16));
 }
@@ -460,7 +705,11 @@ int Platform_GetQueuedSamples(void) {
 }
 
 int Platform_GetTargetSamples(void) {
-    return TARGET_SAMPLES;
+    return targetSamples;
+}
+
+int Platform_GetSampleRate(void) {
+    return sampleRate;
 }
 
 int Platform_GamepadConnected(void) {
@@ -590,6 +839,12 @@ int Platform_Init(void) {
     if (entry) { overscan = entry->data[0]; }
     entry = DB_Find("arcadeColor");
     if (entry) { arcadeColor = entry->data[0]; }
+    entry = DB_Find("jit");
+    if (entry) { jitEnabled = entry->data[0]; }
+    entry = DB_Find("frameskip");
+    if (entry) { frameskipEnabled = entry->data[0]; }
+    entry = DB_Find("audioLatency");
+    if (entry && (entry->data[0] < NUM_AUDIO_LATENCIES)) { audioLatency = entry->data[0]; }
 
     if (!Platform_InitPalettes()) { return 0; }
     Platform_InitNTSC();
@@ -630,7 +885,7 @@ static void Platform_PumpEvents(void) {
                 button = (button - SDL_SCANCODE_LCTRL) + INPUT_KEY_LCTRL;
             }
             if ((button >= INPUT_KEY_A) && (button <= INPUT_KEY_RGUI)) {
-                Input_SetState(button, event.type == SDL_EVENT_KEY_DOWN);
+                Input_SetState(button, event.type == SDL_EVENT_KEY_DOWN, event.key.timestamp);
             }
             break;
 
@@ -649,7 +904,16 @@ static void Platform_PumpEvents(void) {
                 // match the button to the enum in input.h
                 button = gamepadMap[event.gbutton.button];
                 if (button != INPUT_INVALID) {
-                    Input_SetState(button, event.type == SDL_EVENT_GAMEPAD_BUTTON_DOWN);
+                    Input_SetState(button, event.type == SDL_EVENT_GAMEPAD_BUTTON_DOWN, event.gbutton.timestamp);
+                }
+            }
+            break;
+
+        case SDL_EVENT_GAMEPAD_AXIS_MOTION:
+            if (event.gaxis.axis < ARRAY_LEN(triggerMap)) {
+                button = triggerMap[event.gaxis.axis];
+                if (button != INPUT_INVALID) {
+                    Input_SetState(button, event.gaxis.value > TRIGGER_THRESHOLD, event.gaxis.timestamp);
                 }
             }
             break;
@@ -0,0 +1,301 @@
+/* rewind.c: Rewind buffer
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include "alloc.h"
+#include "buffer.h"
+#include "constants.h"
+#include "game.h"
+#include "rewind.h"
+#include "state.h"
+
+// Every frame's state gets XORed against the most recent keyframe (most of
+// the state doesn't change from frame to frame, so this is mostly zeros), then
+// run-length encoded. Keyframes are encoded the same way against all zeros.
+// Encoded states go into one big ring buffer, and when it's full, the oldest
+// keyframe and everything that depends on it gets thrown away.
+
+// how often to store a keyframe
+#define KEYFRAME_INTERVAL (60)
+// maximum number of states to keep (10 minutes), the memory budget will
+// usually run out before this
+#define MAX_ENTRIES (60 * 60 * 10)
+// a stretch of unchanged bytes has to be at least this long to end a literal
+// run, shorter stretches cost more in run headers than they save
+#define MIN_ZERO_RUN (8)
+
+typedef struct {
+    Uint32 offset; // where the entry's data starts in ringData
+    Uint32 size;
+    Uint8 keyframe;
+} RewindEntry;
+
+static Uint8 *ringData = NULL;
+static size_t ringSize;
+// where the next entry goes in ringData
+static size_t ringTail;
+static RewindEntry *entries;
+// index of the oldest entry in entries
+static int oldest;
+static int numEntries;
+static int framesSinceKey;
+static Uint32 session;
+// the keyframe the newest entries are deltas against
+static Buffer *keyState;
+// all zeros, used as the reference for keyframes
+static Buffer *zeroState;
+static Buffer *currState;
+static Uint8 *encoded;
+static int encodedSize;
+
+void Rewind_Init(size_t budget) {
+    ringData = ommalloc(budget);
+    ringSize = budget;
+    entries = ommalloc(MAX_ENTRIES * sizeof(RewindEntry));
+    keyState = Buffer_Init(16 * 1024);
+    zeroState = Buffer_Init(16 * 1024);
+    currState = Buffer_Init(16 * 1024);
+    encoded = NULL;
+    encodedSize = 0;
+    Rewind_Reset();
+}
+
+int Rewind_Enabled(void) {
+    return ringData != NULL;
+}
+
+void Rewind_Reset(void) {
+    ringTail = 0;
+    oldest = 0;
+    numEntries = 0;
+    framesSinceKey = 0;
+    session = Game_SessionNum();
+}
+
+// sets the buffer's size, leaving room for at least one more byte like the
+// Buffer_Add functions do
+static void Rewind_ResizeBuffer(Buffer *buf, int size) {
+    if (size >= buf->allocSize) {
+        while (size >= buf->allocSize) {
+            buf->allocSize *= 2;
+        }
+        buf->data = omrealloc(buf->data, buf->allocSize);
+    }
+    buf->dataSize = size;
+}
+
+static Uint8 *Rewind_PutVarint(Uint8 *out, Uint32 val) {
+    while (val >= 0x80) {
+        *out++ = (Uint8)(val | 0x80);
+        val >>= 7;
+    }
+    *out++ = (Uint8)val;
+    return out;
+}
+
+static const Uint8 *Rewind_GetVarint(const Uint8 *in, Uint32 *val) {
+    Uint32 result = 0;
+    int shift = 0;
+    while (*in & 0x80) {
+        result |= (Uint32)(*in++ & 0x7f) << shift;
+        shift += 7;
+    }
+    result |= (Uint32)(*in++) << shift;
+    *val = result;
+    return in;
+}
+
+// returns the first position at or after pos where a and b differ
+static int Rewind_SkipSame(const Uint8 *a, const Uint8 *b, int pos, int size) {
+    while ((pos + 8) <= size) {
+        Uint64 x, y;
+        memcpy(&x, a + pos, sizeof(x));
+        memcpy(&y, b + pos, sizeof(y));
+        if (x != y) { break; }
+        pos += 8;
+    }
+    while ((pos < size) && (a[pos] == b[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+// format: state size, then (unchanged byte count, changed byte count, changed
+// bytes XOR ref) until the whole state is covered
+static int Rewind_Encode(const Uint8 *state, const Uint8 *ref, int size) {
+    // worst case is alternating changed & unchanged bytes
+    int maxSize = size * 2 + 16;
+    if (encodedSize < maxSize) {
+        encoded = omrealloc(encoded, maxSize);
+        encodedSize = maxSize;
+    }
+
+    Uint8 *out = Rewind_PutVarint(encoded, (Uint32)size);
+    int pos = 0;
+    while (pos < size) {
+        int litStart = Rewind_SkipSame(state, ref, pos, size);
+        int litEnd = litStart;
+        while (litEnd < size) {
+            if (state[litEnd] != ref[litEnd]) {
+                litEnd++;
+                continue;
+            }
+            int same = Rewind_SkipSame(state, ref, litEnd, size);
+            if (((same - litEnd) >= MIN_ZERO_RUN) || (same == size)) { break; }
+            litEnd = same;
+        }
+        out = Rewind_PutVarint(out, (Uint32)(litStart - pos));
+        out = Rewind_PutVarint(out, (Uint32)(litEnd - litStart));
+        for (int i = litStart; i < litEnd; i++) {
+            *out++ = state[i] ^ ref[i];
+        }
+        pos = litEnd;
+    }
+    return (int)(out - encoded);
+}
+
+static void Rewind_Decode(const Uint8 *in, const Buffer *ref, Buffer *out) {
+    Uint32 size;
+    in = Rewind_GetVarint(in, &size);
+    Rewind_ResizeBuffer(out, (int)size);
+    memcpy(out->data, ref->data, size);
+
+    Uint32 pos = 0;
+    while (pos < size) {
+        Uint32 skip, len;
+        in = Rewind_GetVarint(in, &skip);
+        in = Rewind_GetVarint(in, &len);
+        pos += skip;
+        for (Uint32 i = 0; i < len; i++) {
+            out->data[pos++] ^= *in++;
+        }
+    }
+}
+
+// removes the oldest keyframe and all the deltas that depend on it
+static void Rewind_DropOldestGroup(void) {
+    do {
+        oldest = (oldest + 1) % MAX_ENTRIES;
+        numEntries--;
+    } while (numEntries && !entries[oldest].keyframe);
+}
+
+static void Rewind_Store(int size, int keyframe) {
+    if ((size_t)size > ringSize) {
+        Rewind_Reset();
+        return;
+    }
+    if (numEntries == MAX_ENTRIES) {
+        Rewind_DropOldestGroup();
+    }
+
+    // find a contiguous spot for the entry after ringTail
+    while (numEntries) {
+        size_t oldestOffset = entries[oldest].offset;
+        // used space is from the oldest entry to the tail
+        if (ringTail > oldestOffset) {
+            if ((ringTail + size) <= ringSize) { break; }
+            // wrap around to the start
+            if ((size_t)size <= oldestOffset) {
+                ringTail = 0;
+                break;
+            }
+        }
+        // used space is from the oldest entry to the end and the start to the tail
+        else if ((ringTail + size) <= oldestOffset) {
+            break;
+        }
+        Rewind_DropOldestGroup();
+    }
+
+    if (!numEntries) {
+        ringTail = 0;
+        // the keyframe this delta needed got dropped to make room for it
+        if (!keyframe) { return; }
+    }
+
+    RewindEntry *entry = &entries[(oldest + numEntries) % MAX_ENTRIES];
+    entry->offset = (Uint32)ringTail;
+    entry->size = (Uint32)size;
+    entry->keyframe = (Uint8)keyframe;
+    memcpy(ringData + ringTail, encoded, size);
+    ringTail += size;
+    numEntries++;
+}
+
+void Rewind_Push(void) {
+    if (!ringData || !State_Save(currState, 0)) { return; }
+    // states from an earlier game can't be loaded
+    if (session != Game_SessionNum()) {
+        Rewind_Reset();
+    }
+
+    int size = currState->dataSize;
+    int keyframe = !numEntries || (framesSinceKey >= KEYFRAME_INTERVAL) ||
+                   (size != keyState->dataSize);
+    int encodedLen;
+    if (keyframe) {
+        if (zeroState->dataSize < size) {
+            Rewind_ResizeBuffer(zeroState, size);
+            memset(zeroState->data, 0, size);
+        }
+        encodedLen = Rewind_Encode(currState->data, zeroState->data, size);
+        keyState->dataSize = 0;
+        Buffer_AddData(keyState, currState->data, size);
+        framesSinceKey = 0;
+    }
+    else {
+        encodedLen = Rewind_Encode(currState->data, keyState->data, size);
+        framesSinceKey++;
+    }
+    Rewind_Store(encodedLen, keyframe);
+}
+
+int Rewind_Pop(void) {
+    if (!ringData || !numEntries) { return 0; }
+    if (session != Game_SessionNum()) {
+        Rewind_Reset();
+        return 0;
+    }
+
+    int newest = (oldest + numEntries - 1) % MAX_ENTRIES;
+    RewindEntry *entry = &entries[newest];
+    Rewind_Decode(ringData + entry->offset, entry->keyframe ? zeroState : keyState, currState);
+    numEntries--;
+    ringTail = entry->offset;
+
+    if (entry->keyframe) {
+        // the entries before this one are deltas against the previous keyframe
+        framesSinceKey = 0;
+        for (int i = numEntries - 1; i >= 0; i--) {
+            RewindEntry *prev = &entries[(oldest + i) % MAX_ENTRIES];
+            if (prev->keyframe) {
+                Rewind_Decode(ringData + prev->offset, zeroState, keyState);
+                break;
+            }
+            framesSinceKey++;
+        }
+    }
+    else {
+        framesSinceKey--;
+    }
+
+    return State_Load(currState);
+}
@@ -0,0 +1,51 @@
+/* rewind.h: Rewind buffer
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <stddef.h>
+
+/**
+ * @brief Sets up the rewind buffer. Rewinding is off until this is called.
+ * @param budget Maximum number of bytes of compressed states to keep
+ */
+void Rewind_Init(size_t budget);
+
+/**
+ * @brief Checks if rewinding is turned on.
+ * @returns 1 if Rewind_Init was called, 0 otherwise
+ */
+int Rewind_Enabled(void);
+
+/**
+ * @brief Throws away every state in the rewind buffer.
+ */
+void Rewind_Reset(void);
+
+/**
+ * @brief Saves the current game state to the rewind buffer, dropping the oldest
+ * states if it's full. Only does anything when State_Available() is true.
+ */
+void Rewind_Push(void);
+
+/**
+ * @brief Loads the most recently pushed state and removes it from the rewind
+ * buffer, so calling this every frame steps backwards one frame at a time.
+ * @returns 1 if a state was loaded, 0 if the buffer is empty
+ */
+int Rewind_Pop(void);
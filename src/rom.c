@@ -134,9 +134,9 @@ int Rom_LoadChr(char *filename, int size) {
     return 1;
 }
 
-static int init_tileset(MapData *data, int num, int length, Uint16 base, int pal_offset, int rom_offset) {
+static int init_tileset(Arena *arena, MapData *data, int num, int length, Uint16 base, int pal_offset, int rom_offset) {
     data->tilesets[num].len = length;
-    data->tilesets[num].metatiles = ommalloc(length * sizeof(Metatile));
+    data->tilesets[num].metatiles = Arena_Alloc(arena, length * sizeof(Metatile));
     for (int i = 0; i < length; i++) {
         data->tilesets[num].metatiles[i].palnum   = (Uint16)prgRom[pal_offset++];
         data->tilesets[num].metatiles[i].tiles[0] = (Uint16)prgRom[rom_offset++] + base;
@@ -148,30 +148,30 @@ static int init_tileset(MapData *data, int num, int length, Uint16 base, int pal
     return rom_offset;
 }
 
-MapData *Rom_GetMapData(void) {
-    MapData *data = ommalloc(sizeof(MapData));
+MapData *Rom_GetMapData(Arena *arena) {
+    MapData *data = Arena_Alloc(arena, sizeof(MapData));
     // position in the PRG ROM
     int cursor = 0;
 
     // there are 3 tilesets (forest, cave, castle)
     data->numTilesets = 3;
-    data->tilesets = ommalloc(data->numTilesets * sizeof(Tileset));
+    data->tilesets = Arena_Alloc(arena, data->numTilesets * sizeof(Tileset));
 
     // forest tileset has 164 metatiles
     #define FOREST_PALS (0x2790)
-    cursor = init_tileset(data, 0, 164, tilesetBases[0], FOREST_PALS, cursor);
+    cursor = init_tileset(arena, data, 0, 164, tilesetBases[0], FOREST_PALS, cursor);
 
     // cave tileset has 164 metatiles
     #define CAVE_PALS (0x2834)
-    cursor = init_tileset(data, 1, 164, tilesetBases[1], CAVE_PALS, cursor);
+    cursor = init_tileset(arena, data, 1, 164, tilesetBases[1], CAVE_PALS, cursor);
 
     // castle tileset has 164 metatiles (noticing a pattern?)
     #define CASTLE_PALS (0x28d8)
-    cursor = init_tileset(data, 2, 164, tilesetBases[2], CASTLE_PALS, cursor);
+    cursor = init_tileset(arena, data, 2, 164, tilesetBases[2], CASTLE_PALS, cursor);
 
     // there are 223 chunks
     data->numChunks = 223;
-    data->chunks = ommalloc(data->numChunks * sizeof(data->chunks[0]));
+    data->chunks = Arena_Alloc(arena, data->numChunks * sizeof(data->chunks[0]));
     for (int i = 0; i < data->numChunks; i++) {
         for (int j = 0; j < ARRAY_LEN(data->chunks[0]); j++) {
             data->chunks[i][j] = (Uint16)prgRom[cursor++];
@@ -180,7 +180,7 @@ MapData *Rom_GetMapData(void) {
 
     // there are 159 screens
     data->numScreens = 159;
-    data->screens = ommalloc(data->numScreens * sizeof(data->screens[0]));
+    data->screens = Arena_Alloc(arena, data->numScreens * sizeof(data->screens[0]));
     for (int i = 0; i < data->numScreens; i++) {
         for (int j = 0; j < ARRAY_LEN(data->screens[0]); j++) {
             data->screens[i][j] = (Uint16)prgRom[cursor++];
@@ -189,7 +189,7 @@ MapData *Rom_GetMapData(void) {
 
     // there are 16 rooms
     data->numRooms = 16;
-    data->rooms = ommalloc(data->numRooms * sizeof(Room));
+    data->rooms = Arena_Alloc(arena, data->numRooms * sizeof(Room));
     for (int i = 0; i < 16; i++) {
         // get tileset
         #define ROOM_BANK_TBL (0x44bf)
@@ -211,13 +211,17 @@ MapData *Rom_GetMapData(void) {
         // dimensions
         data->rooms[i].width = 8;
         data->rooms[i].height = 8;
-        data->rooms[i].screenNums = ommalloc(data->rooms[i].width * data->rooms[i].height * sizeof(Uint16));
+        data->rooms[i].screenNums = Arena_Alloc(arena, data->rooms[i].width * data->rooms[i].height * sizeof(Uint16));
 
         // copy room data
         int numScreens = data->rooms[i].width * data->rooms[i].height;
         for (int j = 0; j < numScreens; j++) {
             data->rooms[i].screenNums[j] = (Uint16)prgRom[cursor++];
         }
+        // filled in by Map_LoadRooms
+        data->rooms[i].metatiles = NULL;
+        data->rooms[i].planes = NULL;
+        data->rooms[i].doorGrid = NULL;
         // in the original game, enemies were stored as offsets from a base
         // value that depended on the room number
         int room_sprite_bank = prgRom[ROOM_BANK_TBL + i] & 0x3;
@@ -273,7 +277,7 @@ MapData *Rom_GetMapData(void) {
     #define WARP_DOOR_ROOM_TBL (0x423a)
     
     data->numWarpDoors = 272;
-    data->warpDoors = ommalloc(data->numWarpDoors * sizeof(WarpDoor));
+    data->warpDoors = Arena_Alloc(arena, data->numWarpDoors * sizeof(WarpDoor));
     for (int i = 0; i < data->numWarpDoors; i++) {
         data->warpDoors[i].xPos = prgRom[WARP_DOOR_X_TBL + i];
         data->warpDoors[i].yPos = prgRom[WARP_DOOR_Y_TBL + i];
@@ -282,8 +286,8 @@ MapData *Rom_GetMapData(void) {
     return data;
 }
 
-MapData *Rom_GetMapDataArcade(void) {
-    MapData *data = Rom_GetMapData();
+MapData *Rom_GetMapDataArcade(Arena *arena) {
+    MapData *data = Rom_GetMapData(arena);
     // room 0's palette is changed to be the same as room 1's
     memcpy(data->rooms[0].palette, data->rooms[1].palette, sizeof(data->rooms[0].palette));
 
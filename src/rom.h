@@ -18,6 +18,7 @@
  */
 
 #pragma once
+#include "alloc.h"
 #include "constants.h"
 #include "map.h"
 
@@ -44,12 +45,14 @@ int Rom_LoadChr(char *filename, int size);
 
 /**
  * @brief allocates a MapData struct and fills it with map data from the ROM image
+ * @param arena the arena to allocate the map data from
 */
-MapData *Rom_GetMapData(void);
+MapData *Rom_GetMapData(Arena *arena);
 
 /**
  * @brief allocates a MapData struct and fills it with map data from the arcade ROM
  * (still uses the console ROM, patches the level data to match the arcade version)
+ * @param arena the arena to allocate the map data from
  */
-MapData *Rom_GetMapDataArcade(void);
+MapData *Rom_GetMapDataArcade(Arena *arena);
 
@@ -26,19 +26,25 @@ extern "C" {
     #include "buffer.h"
     #include "constants.h"
     #include "db.h"
+    #include "file.h"
     #include "game.h"
     #include "mml.h"
     #include "platform.h"
     #include "rom.h"
     #include "sound.h"
+    #include "soundcache.h"
     #include "util.h"
 }
 
 #include "Simple_Apu.h"
 
-// audio settings
-#define SOUND_FREQ 44100
-#define SAMPLES_PER_FRAME (SOUND_FREQ / 60)
+// audio settings (we run at whatever rate the platform layer's audio output
+// uses, so Blip_Buffer does the only resampling)
+static int soundFreq;
+// the sound engine can run up to twice per Sound_Run call, +1 for rounding
+#define MIX_BUFF_SAMPLES(freq) (((freq) / 60 + 1) * 2)
+static Sint16 *mixBuff0;
+static Sint16 *mixBuff1;
 
 static Simple_Apu apus[2];
 
@@ -96,10 +102,15 @@ static Instrument savedMusInstruments[NUM_INSTRUMENTS];
 #define APU_CHANNELS 4
 static Uint8 channelsInUse[APU_CHANNELS * 2];
 static Uint8 apuStatusCopy[2];
+// the last value written to each channel register ($4000-$400F) of each APU
+static Uint8 apuRegs[2][APU_CHANNELS * 4];
 // 0-100
 static int volume = 50;
 static int muted;
+// when set, Sound_Play does nothing
+static int headless;
 
+static void Sound_WriteRegister(int apu, int addr, Uint8 data);
 static void Sound_RunInstrument(int apu, Instrument *inst);
 static void Sound_DisableChannel(int apu, Uint8 channel);
 static void Sound_EnableChannel(int apu, Uint8 channel);
@@ -157,9 +168,39 @@ static Uint8 *Sound_LoadData(Uint8 *romData, Sound *out) {
     return romData + cursor;
 }
 
+// loads the given MML file out of the sound cache, compiling it if it's not
+// cached (or the cached copy is out of date)
+static int Sound_LoadMML(const char *filename, Sound *out) {
+    FILE *fp = File_OpenResource(filename, "rb");
+    if (!fp) { return 0; }
+    int size;
+    char *text = reinterpret_cast<char *>(File_Load(fp, &size));
+    Uint64 modTime = File_GetModTime(fp);
+    fclose(fp);
+    Uint32 hash = Util_Hash(UTIL_HASH_INIT, text, size);
+
+    int success = SoundCache_Find(filename, (Uint32)size, modTime, hash, out);
+    if (!success) {
+        printf("--- Compiling %s ---\n", filename);
+        MMLError error;
+        success = MML_CompileMem(text, size, out, &error);
+        if (success) {
+            SoundCache_Add(filename, (Uint32)size, modTime, hash, out);
+        }
+        else {
+            printf("Line %d column %d: %s\n", error.line, error.column, error.message);
+        }
+    }
+    free(text);
+    return success;
+}
+
 void Sound_Init(void) {
-    apus[0].sample_rate(SOUND_FREQ);
-    apus[1].sample_rate(SOUND_FREQ);
+    soundFreq = Platform_GetSampleRate();
+    apus[0].sample_rate(soundFreq);
+    apus[1].sample_rate(soundFreq);
+    mixBuff0 = static_cast<Sint16 *>(ommalloc(MIX_BUFF_SAMPLES(soundFreq) * sizeof(Sint16)));
+    mixBuff1 = static_cast<Sint16 *>(ommalloc(MIX_BUFF_SAMPLES(soundFreq) * sizeof(Sint16)));
 
     DBEntry *entry = DB_Find("volume");
     if (entry) {
@@ -172,11 +213,12 @@ void Sound_Init(void) {
 }
 
 int Sound_LoadGameSounds(void) {
+    SoundCache_Init();
     // load sound data from the ROM
     Uint8 *src = chrRom + CHR_ROM_SOUND;
     for (int i = 0; i < NUM_ROM_SOUNDS; i++) {
         // override the sound with MML file if one is available
-        if (MML_Compile(soundFilenames[i], &sounds[i])) {
+        if (Sound_LoadMML(soundFilenames[i], &sounds[i])) {
             // skip past the sound definition in the ROM
             int count = (int)(*src++);
             src += (count * 7);
@@ -210,19 +252,25 @@ int Sound_LoadGameSounds(void) {
     }
     for (int i = NUM_ROM_SOUNDS; i < NUM_SOUNDS; i++) {
         // these sounds aren't in the ROM, so if the MML is missing or broken we have to abort
-        if (!MML_Compile(soundFilenames[i], &sounds[i])) {
+        if (!Sound_LoadMML(soundFilenames[i], &sounds[i])) {
             Platform_ShowError("Error compiling %s", soundFilenames[i]);
             return 0;
         }
     }
+    SoundCache_Save();
+    for (int i = 0; i < NUM_SOUNDS; i++) {
+        Sound_Decode(&sounds[i]);
+    }
     return 1;
 }
 
 int Sound_SetVolume(int vol) {
     volume = vol;
     CLAMP(volume, 0, 100);
+    Platform_LockAudio();
     apus[0].volume(volume);
     apus[1].volume(volume);
+    Platform_UnlockAudio();
     Uint8 volumeByte = (Uint8)volume;
     DB_Set("volume", &volumeByte, 1);
     DB_Save();
@@ -241,6 +289,10 @@ void Sound_Unmute(void) {
     muted = 0;
 }
 
+void Sound_SetHeadless(int on) {
+    headless = on;
+}
+
 char *Sound_GetDebugText(int num) {
     static char output[256] = {0};
     char row[64];
@@ -269,6 +321,9 @@ char *Sound_GetDebugText(int num) {
 }
 
 void Sound_Reset(void) {
+    if (headless) { return; }
+
+    Platform_LockAudio();
     // initialize sound engine state
     for (int i = 0; i < NUM_INSTRUMENTS; i++) {
         instruments[i].cursor = 0xffff;
@@ -276,15 +331,18 @@ void Sound_Reset(void) {
     }
     apuStatusCopy[0] = 0;
     apuStatusCopy[1] = 0;
-    apus[0].write_register(0x4015, apuStatusCopy[0]);
-    apus[1].write_register(0x4015, apuStatusCopy[1]);
+    Sound_WriteRegister(0, 0x4015, apuStatusCopy[0]);
+    Sound_WriteRegister(1, 0x4015, apuStatusCopy[1]);
     /*
     blip_bufs[0].clear();
     blip_bufs[1].clear();
     */
+    Platform_UnlockAudio();
 }
 
 void Sound_Play(int num) {
+    if (headless) { return; }
+
     // copy all instruments from a sound into their respective slots
     Instrument *destInsts;
     int apu;
@@ -296,6 +354,7 @@ void Sound_Play(int num) {
         destInsts = instruments;
         apu = 0;
     }
+    Platform_LockAudio();
     for (int i = 0; i < sounds[num].count; i++) {
         Uint8 instNum = sounds[num].data[i].num;
         // turn off the channel for the previous instrument in this slot
@@ -310,14 +369,18 @@ void Sound_Play(int num) {
         destInsts[instNum].loop = 0xff;
         destInsts[instNum].ctrlRegsSet = 0xff;
     }
+    Platform_UnlockAudio();
 }
 
 void Sound_SaveState(void) {
+    Platform_LockAudio();
     memcpy(savedInstruments, instruments, sizeof(instruments));
     memcpy(savedMusInstruments, musInstruments, sizeof(musInstruments));
+    Platform_UnlockAudio();
 }
 
 void Sound_LoadState(void) {
+    Platform_LockAudio();
     memcpy(instruments, savedInstruments, sizeof(instruments));
     memcpy(musInstruments, savedMusInstruments, sizeof(musInstruments));
     // make sure each instrument sets its APU registers
@@ -325,6 +388,59 @@ void Sound_LoadState(void) {
         instruments[i].ctrlRegsSet = 0xff;
         musInstruments[i].ctrlRegsSet = 0xff;
     }
+    Platform_UnlockAudio();
+}
+
+void Sound_SaveSnapshot(Buffer *buf) {
+    // in low latency mode, the audio callback runs the sound engine
+    Platform_LockAudio();
+    Buffer_AddData(buf, reinterpret_cast<Uint8 *>(instruments), sizeof(instruments));
+    Buffer_AddData(buf, reinterpret_cast<Uint8 *>(savedInstruments), sizeof(savedInstruments));
+    Buffer_AddData(buf, reinterpret_cast<Uint8 *>(musInstruments), sizeof(musInstruments));
+    Buffer_AddData(buf, reinterpret_cast<Uint8 *>(savedMusInstruments), sizeof(savedMusInstruments));
+    Buffer_AddData(buf, channelsInUse, sizeof(channelsInUse));
+    Buffer_AddData(buf, apuStatusCopy, sizeof(apuStatusCopy));
+    Buffer_AddData(buf, &apuRegs[0][0], sizeof(apuRegs));
+    Platform_UnlockAudio();
+}
+
+int Sound_LoadSnapshot(Buffer *buf, int index) {
+    Platform_LockAudio();
+    Buffer_ReadData(buf, index, instruments, sizeof(instruments));
+    index += sizeof(instruments);
+    Buffer_ReadData(buf, index, savedInstruments, sizeof(savedInstruments));
+    index += sizeof(savedInstruments);
+    Buffer_ReadData(buf, index, musInstruments, sizeof(musInstruments));
+    index += sizeof(musInstruments);
+    Buffer_ReadData(buf, index, savedMusInstruments, sizeof(savedMusInstruments));
+    index += sizeof(savedMusInstruments);
+    Buffer_ReadData(buf, index, channelsInUse, sizeof(channelsInUse));
+    index += sizeof(channelsInUse);
+    Uint8 status[2];
+    Buffer_ReadData(buf, index, status, sizeof(status));
+    index += sizeof(status);
+    Uint8 regs[2][sizeof(apuRegs[0])];
+    Buffer_ReadData(buf, index, regs, sizeof(regs));
+    index += sizeof(regs);
+
+    // The APU emulator's internal state (oscillator phase, envelopes, etc.)
+    // isn't saved, so put it back in sync by writing the saved registers.
+    // Only registers that differ get written, since writing the period high
+    // registers restarts the note. The status register goes first so the
+    // length counters of enabled channels get loaded.
+    for (int apu = 0; apu < 2; apu++) {
+        if (status[apu] != apuStatusCopy[apu]) {
+            apuStatusCopy[apu] = status[apu];
+            Sound_WriteRegister(apu, 0x4015, apuStatusCopy[apu]);
+        }
+        for (int reg = 0; reg < (int)sizeof(regs[0]); reg++) {
+            if (regs[apu][reg] != apuRegs[apu][reg]) {
+                Sound_WriteRegister(apu, 0x4000 + reg, regs[apu][reg]);
+            }
+        }
+    }
+    Platform_UnlockAudio();
+    return index;
 }
 
 static void Sound_RunEngine(void) {
@@ -336,8 +452,10 @@ static void Sound_RunEngine(void) {
 }
 
 void Sound_Run(void) {
-    static Sint16 buff0[SAMPLES_PER_FRAME * 2];
-    static Sint16 buff1[SAMPLES_PER_FRAME * 2];
+    // in low latency mode, the audio callback runs the sound engine instead
+    if (Platform_GetAudioLatency() != AUDIO_LATENCY_NORMAL) {
+        return;
+    }
 
     // find the number of samples we need to fill up the audio buffer
     Sint32 queuedSamples = Platform_GetQueuedSamples();
@@ -358,18 +476,52 @@ void Sound_Run(void) {
         apus[1].end_frame();
     }
 
-    apus[0].read_samples(buff0, ARRAY_LEN(buff0));
-    Sint32 outputSamples = apus[1].read_samples(buff1, ARRAY_LEN(buff1));
+    apus[0].read_samples(mixBuff0, MIX_BUFF_SAMPLES(soundFreq));
+    Sint32 outputSamples = apus[1].read_samples(mixBuff1, MIX_BUFF_SAMPLES(soundFreq));
     if (muted) {
-        memset(buff0, 0, sizeof(buff0));
+        memset(mixBuff0, 0, outputSamples * sizeof(Sint16));
     }
     else {
         // mix output from both APUs together
         for (int i = 0; i < outputSamples; i++) {
-            buff0[i] += buff1[i];
+            mixBuff0[i] += mixBuff1[i];
         }
     }
-    Platform_QueueSamples(buff0, outputSamples);
+    Platform_QueueSamples(mixBuff0, outputSamples);
+}
+
+void Sound_FillBuffer(Sint16 *out, int count) {
+    // the audio device can start asking for samples before Sound_Init runs
+    if (!mixBuff0) {
+        memset(out, 0, count * sizeof(Sint16));
+        return;
+    }
+
+    while (count > 0) {
+        // only run the engine once we've used up all the samples from the
+        // last frame, so it still runs 60 times per second of audio
+        if (!apus[0].samples_avail()) {
+            Sound_RunEngine();
+            apus[0].end_frame();
+            apus[1].end_frame();
+        }
+        long chunk = apus[0].samples_avail();
+        if (chunk > count) { chunk = count; }
+        if (chunk > MIX_BUFF_SAMPLES(soundFreq)) { chunk = MIX_BUFF_SAMPLES(soundFreq); }
+        Sint32 outputSamples = apus[0].read_samples(out, chunk);
+        apus[1].read_samples(mixBuff1, chunk);
+        if (muted) {
+            memset(out, 0, outputSamples * sizeof(Sint16));
+        }
+        else {
+            // mix output from both APUs together
+            for (int i = 0; i < outputSamples; i++) {
+                out[i] += mixBuff1[i];
+            }
+        }
+        out += outputSamples;
+        count -= outputSamples;
+    }
 }
 
 static Uint16 freqTbl[] = {
@@ -387,11 +539,95 @@ static Uint16 freqTbl[] = {
     0x714,
 };
 
+static SoundOp *Sound_DecodeInstrument(Instrument *inst) {
+    // find the end of the data ("end of track" or a backwards jump)
+    int count = 0;
+    while (1) {
+        Uint8 cmd = inst->data[count * 3];
+        Uint16 param = Util_LoadUint16(inst->data + (count * 3) + 1);
+        count++;
+        if (((cmd == 0xbf) && (param < count)) || (cmd == 0xff)) {
+            break;
+        }
+    }
+
+    SoundOp *ops = static_cast<SoundOp *>(ommalloc(count * sizeof(SoundOp)));
+    for (int i = 0; i < count; i++) {
+        Uint8 *read = inst->data + (i * 3);
+        Uint8 cmd = read[0];
+        Uint16 param = Util_LoadUint16(read + 1);
+        SoundOp *op = &ops[i];
+        op->arg = cmd;
+        op->param = param;
+        op->period = 0;
+
+        if (cmd == 0xff) {
+            op->type = SOUND_OP_END;
+        }
+        // a0-af: APU register setting
+        else if ((cmd >= 0xa0) && (cmd < 0xb0)) {
+            op->type = (cmd & 1) ? SOUND_OP_REG1 : SOUND_OP_REG0;
+            op->arg = (Uint8)param;
+        }
+        // bf: jump
+        else if (cmd == 0xbf) {
+            op->type = SOUND_OP_JUMP;
+        }
+        // b0-be: loop
+        else if ((cmd >= 0xb0) && (cmd < 0xc0)) {
+            op->type = SOUND_OP_LOOP;
+            op->arg = cmd & 0xf;
+        }
+        // >= c0 or < a0: play note
+        // noise channel: the command gets written to the registers directly
+        else if (inst->channel == 3) {
+            op->type = SOUND_OP_NOISE;
+        }
+        else if ((cmd & 0xf) >= 0xc) {
+            op->type = SOUND_OP_KEY_OFF;
+        }
+        else {
+            op->type = SOUND_OP_NOTE;
+            Uint8 note = cmd & 0xf;
+            Uint8 octave = cmd >> 4;
+            op->period = freqTbl[note] >> (octave + 1);
+        }
+    }
+    return ops;
+}
+
+void Sound_Decode(Sound *sound) {
+    for (int i = 0; i < sound->count; i++) {
+        sound->data[i].ops = Sound_DecodeInstrument(&sound->data[i]);
+    }
+}
+
+// gcc & clang support jumping straight to the next op's handler, which lets
+// the branch predictor track each handler's jump separately
+#if defined(__GNUC__)
+#define SOUND_DISPATCH(op) goto *opLabels[(op)->type]
+#else
+#define SOUND_DISPATCH(op) \
+    switch ((op)->type) { \
+    case SOUND_OP_REG0:    goto opReg0; \
+    case SOUND_OP_REG1:    goto opReg1; \
+    case SOUND_OP_JUMP:    goto opJump; \
+    case SOUND_OP_LOOP:    goto opLoop; \
+    case SOUND_OP_NOTE:    goto opNote; \
+    case SOUND_OP_NOISE:   goto opNoise; \
+    case SOUND_OP_KEY_OFF: goto opKeyOff; \
+    default:               goto opEnd; \
+    }
+#endif
+
 static void Sound_RunInstrument(int apu, Instrument *inst) {
+#if defined(__GNUC__)
+    static const void *opLabels[NUM_SOUND_OPS] = {
+        &&opReg0, &&opReg1, &&opJump, &&opLoop, &&opNote, &&opNoise, &&opKeyOff, &&opEnd,
+    };
+#endif
     Uint8 reg2, reg3;
-    Uint8 *read;
-    Uint8 cmd;
-    Uint16 param;
+    SoundOp *op;
     int regOffset;
 
     // "instrument not playing" flag
@@ -402,88 +638,82 @@ static void Sound_RunInstrument(int apu, Instrument *inst) {
     if (inst->timer) {
         // "instrument still playing a note" flag
         reg2 = 0x6F;
+        goto setRegs;
     }
-    else {
-        setReadPtr:
-        read = inst->data + (inst->cursor * 3);
-        getCmd:
-        if (*read == 0xff) {
-            inst->cursor = 0xffff;
-            inst->loop = 0xff;
-            channelsInUse[(apu * APU_CHANNELS) + inst->channel] = 0;
-            Sound_DisableChannel(apu, inst->channel);
-            goto lostChannel;
-        }
 
-        cmd = *read++;
-        param = Util_LoadUint16(read);
-        read += 2;
+    op = inst->ops + inst->cursor;
+    SOUND_DISPATCH(op);
 
-        // a0-af: APU register setting
-        if ((cmd >= 0xa0) && (cmd < 0xb0)) {
-            if (cmd & 1) {
-                inst->reg1 = (Uint8)param;
-            }
-            else {
-                inst->reg0 = (Uint8)param;
-            }
-            inst->cursor++;
-            inst->ctrlRegsSet = 0xff;
-            goto getCmd;
-        }
-        // b0-bf: looping/jumping
-        else if ((cmd >= 0xb0) && (cmd < 0xc0)) {
-            if (cmd == 0xbf) {
-                inst->cursor = param;
-                goto setReadPtr;
-            }
-            // loop over: set to 0xff (no loop) and move on
-            if (!inst->loop) {
-                inst->loop--;
-                inst->cursor++;
-                goto getCmd;
-            }
-            // new loop
-            if (inst->loop == 0xff) {
-                inst->loop = cmd & 0xf;
-            }
-            // loop in progress
-            else {
-                inst->loop--;
-            }
-            inst->cursor = param;
-            goto setReadPtr;
-        }
-        // >= c0 or < a0: play note
-        else {
-            inst->cursor++;
-
-            // noise channel: set registers directly
-            if (inst->channel == 3) {
-                reg2 = cmd;
-                reg3 = 0;
-            }
-            // key off
-            else if ((cmd & 0xf) >= 0xc) {
-                Sound_DisableChannel(apu, inst->channel);
-                reg2 = 0x6f;
-                reg3 = 0;
-            }
-            else {
-                Uint8 note = cmd & 0xf;
-                Uint8 octave = cmd >> 4;
-                Uint16 freq = freqTbl[note];
-                freq >>= (octave + 1);
-                reg2 = freq & 0xff;
-                reg3 = freq >> 8;
-            }
+opReg0:
+    inst->reg0 = op->arg;
+    inst->cursor++;
+    inst->ctrlRegsSet = 0xff;
+    op++;
+    SOUND_DISPATCH(op);
 
-            inst->lastNote = cmd;
-            inst->timer = param;
-            // length counter load
-            reg3 |= 8;
-        }
+opReg1:
+    inst->reg1 = op->arg;
+    inst->cursor++;
+    inst->ctrlRegsSet = 0xff;
+    op++;
+    SOUND_DISPATCH(op);
+
+opJump:
+    inst->cursor = op->param;
+    op = inst->ops + inst->cursor;
+    SOUND_DISPATCH(op);
+
+opLoop:
+    // loop over: set to 0xff (no loop) and move on
+    if (!inst->loop) {
+        inst->loop--;
+        inst->cursor++;
+        op++;
+        SOUND_DISPATCH(op);
+    }
+    // new loop
+    if (inst->loop == 0xff) {
+        inst->loop = op->arg;
     }
+    // loop in progress
+    else {
+        inst->loop--;
+    }
+    inst->cursor = op->param;
+    op = inst->ops + inst->cursor;
+    SOUND_DISPATCH(op);
+
+opEnd:
+    inst->cursor = 0xffff;
+    inst->loop = 0xff;
+    channelsInUse[(apu * APU_CHANNELS) + inst->channel] = 0;
+    Sound_DisableChannel(apu, inst->channel);
+    goto lostChannel;
+
+opNoise:
+    // noise channel: set registers directly
+    reg2 = op->arg;
+    reg3 = 0;
+    goto playNote;
+
+opKeyOff:
+    Sound_DisableChannel(apu, inst->channel);
+    reg2 = 0x6f;
+    reg3 = 0;
+    goto playNote;
+
+opNote:
+    reg2 = op->period & 0xff;
+    reg3 = op->period >> 8;
+
+playNote:
+    inst->cursor++;
+    inst->lastNote = op->arg;
+    inst->timer = op->param;
+    // length counter load
+    reg3 |= 8;
+
+setRegs:
     // set up apu regs
     if (channelsInUse[(apu * APU_CHANNELS) + inst->channel]) {
         goto lostChannel;
@@ -495,26 +725,33 @@ static void Sound_RunInstrument(int apu, Instrument *inst) {
     Sound_EnableChannel(apu, inst->channel);
     regOffset = inst->channel * 4;
     if (inst->ctrlRegsSet) {
-        apus[apu].write_register(0x4001 + regOffset, inst->reg1);
-        apus[apu].write_register(0x4000 + regOffset, inst->reg0);
+        Sound_WriteRegister(apu, 0x4001 + regOffset, inst->reg1);
+        Sound_WriteRegister(apu, 0x4000 + regOffset, inst->reg0);
     }
-    apus[apu].write_register(0x4002 + regOffset, reg2);
-    apus[apu].write_register(0x4003 + regOffset, reg3);
+    Sound_WriteRegister(apu, 0x4002 + regOffset, reg2);
+    Sound_WriteRegister(apu, 0x4003 + regOffset, reg3);
     inst->ctrlRegsSet = 0;
     return;
 
-    lostChannel:
+lostChannel:
     // when an instrument loses access to its channel, it has to reset its
     // registers when it regains access
     inst->ctrlRegsSet = 0xff;
 }
 
+static void Sound_WriteRegister(int apu, int addr, Uint8 data) {
+    if (addr < (0x4000 + (int)sizeof(apuRegs[0]))) {
+        apuRegs[apu][addr - 0x4000] = data;
+    }
+    apus[apu].write_register(addr, data);
+}
+
 static void Sound_DisableChannel(int apu, Uint8 channel) {
     apuStatusCopy[apu] &= ~(1 << channel);
-    apus[apu].write_register(0x4015, apuStatusCopy[apu]);
+    Sound_WriteRegister(apu, 0x4015, apuStatusCopy[apu]);
 }
 
 static void Sound_EnableChannel(int apu, Uint8 channel) {
     apuStatusCopy[apu] |= (1 << channel);
-    apus[apu].write_register(0x4015, apuStatusCopy[apu]);
+    Sound_WriteRegister(apu, 0x4015, apuStatusCopy[apu]);
 }
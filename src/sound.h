@@ -18,6 +18,7 @@
  */
 
 #pragma once
+#include "buffer.h"
 
 typedef enum {
     MUS_TITLE       = 0,
@@ -57,10 +58,38 @@ typedef enum {
     NUM_SOUNDS,
 } SOUND_NUM;
 
+// sound engine operations (see Sound_Decode)
+typedef enum {
+    SOUND_OP_REG0,
+    SOUND_OP_REG1,
+    SOUND_OP_JUMP,
+    SOUND_OP_LOOP,
+    SOUND_OP_NOTE,
+    SOUND_OP_NOISE,
+    SOUND_OP_KEY_OFF,
+    SOUND_OP_END,
+    NUM_SOUND_OPS,
+} SOUND_OP_TYPE;
+
+// a decoded sound command
+typedef struct {
+    // SOUND_OP_TYPE
+    Uint8 type;
+    // register value, loop count, or the original command byte for notes
+    Uint8 arg;
+    // note length in frames, or jump/loop destination
+    Uint16 param;
+    // precalculated APU timer period for notes
+    Uint16 period;
+} SoundOp;
+
 // state of a playing instrument
 typedef struct {
     Uint8 num;
+    // sound bytecode (3 bytes per command: command byte, then big endian parameter)
     Uint8 *data;
+    // the bytecode decoded by Sound_Decode, this is what actually gets played
+    SoundOp *ops;
     Uint8 channel;
     Uint16 cursor;
     Uint8 reg0;
@@ -91,6 +120,14 @@ void Sound_Init(void);
  */
 int Sound_LoadGameSounds(void);
 
+/**
+ * @brief Decodes a sound's bytecode into the ops the sound engine plays
+ * back. Needs to be run on any sound that doesn't come from
+ * Sound_LoadGameSounds before it's played.
+ * @param sound the sound to decode
+ */
+void Sound_Decode(Sound *sound);
+
 /**
  * @brief Sets the volume.
  * @param vol Percentage (0-100)
@@ -113,6 +150,14 @@ void Sound_Mute(void);
  */
 void Sound_Unmute(void);
 
+/**
+ * @brief Turns headless mode on or off. In headless mode, Sound_Play and
+ * Sound_Reset do nothing, so game logic can be run without touching the
+ * sound engine state.
+ * @param on 1 to turn on headless mode, 0 to turn it off
+ */
+void Sound_SetHeadless(int on);
+
 /**
  * @param num Sound number we want to inspect (picks the correct APU)
  * @returns informative text about the state of the sound engine (mainly used
@@ -146,3 +191,27 @@ void Sound_LoadState(void);
  * you want audio playing
 */
 void Sound_Run(void);
+
+/**
+ * @brief Runs the sound engine until it's produced the given number of
+ * samples. Used by the platform layer's audio callback in low latency mode
+ * (in normal mode, Sound_Run pushes samples out instead).
+ * @param out where to write the samples
+ * @param count how many samples to write
+ */
+void Sound_FillBuffer(Sint16 *out, int count);
+
+/**
+ * @brief Adds the sound engine state and APU registers to a state snapshot
+ * @param buf buffer to add to
+ */
+void Sound_SaveSnapshot(Buffer *buf);
+
+/**
+ * @brief Restores the sound engine state from a state snapshot, and writes
+ * the saved register values back to the APUs
+ * @param buf buffer to read from
+ * @param index where the sound state starts in the buffer
+ * @returns the index right after the sound state
+ */
+int Sound_LoadSnapshot(Buffer *buf, int index);
@@ -0,0 +1,250 @@
+/* soundcache.c: Compiled MML cache
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// cache file spec (all numbers are big endian)
+// Uint32: magic ("OMSC")
+// Uint32: version (bump this whenever the bytecode format changes)
+// Uint32: num entries
+// each entry:
+// Uint8: name length (including NUL terminator)
+// name
+// Uint32: MML file size
+// Uint32: MML file modification time (high 32 bits)
+// Uint32: MML file modification time (low 32 bits)
+// Uint32: MML file hash
+// Uint8: isMusic
+// Uint8: instrument count
+// each instrument:
+// Uint8: num
+// Uint8: channel
+// Uint8: reg1
+// Uint8: reg0
+// Uint32: bytecode length
+// bytecode
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "alloc.h"
+#include "constants.h"
+#include "file.h"
+#include "soundcache.h"
+#include "util.h"
+
+#define CACHE_FILENAME "soundcache.bin"
+#define CACHE_MAGIC 0x4f4d5343
+#define CACHE_VERSION 1
+
+typedef struct {
+    char *name;
+    Uint32 size;
+    Uint64 modTime;
+    Uint32 hash;
+    // set when the entry gets used this session, unused entries don't get saved
+    Uint8 used;
+    Sound sound;
+} CacheEntry;
+
+static int numEntries;
+static int allocedEntries;
+static CacheEntry *entries;
+static int dirty;
+// raw contents of the cache file, entries point directly into this
+static Uint8 *cacheData;
+
+static CacheEntry *SoundCache_FindEntry(const char *filename) {
+    for (int i = 0; i < numEntries; i++) {
+        if (strcmp(entries[i].name, filename) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static CacheEntry *SoundCache_NewEntry(void) {
+    if (numEntries >= allocedEntries) {
+        allocedEntries *= 2;
+        entries = omrealloc(entries, allocedEntries * sizeof(CacheEntry));
+    }
+    return &entries[numEntries++];
+}
+
+// The MML compiler always ends an instrument with either a loop (0xbf) or an
+// "end of track" (0xff) command, and neither of those can show up anywhere
+// else in compiled MML, so the first one we see marks the end of the data.
+static Uint32 SoundCache_DataLen(Uint8 *data) {
+    Uint32 len = 0;
+    while (1) {
+        Uint8 cmd = data[len];
+        len += 3;
+        if ((cmd == 0xbf) || (cmd == 0xff)) {
+            return len;
+        }
+    }
+}
+
+// returns 1 if the cache file parsed correctly, 0 if it's truncated or corrupt
+static int SoundCache_Parse(int cacheSize) {
+    Uint8 *cursor = cacheData;
+    Uint8 *end = cacheData + cacheSize;
+
+#define CHECK_LEN(len) if ((end - cursor) < (len)) { return 0; }
+    CHECK_LEN(12);
+    if (Util_LoadUint32(cursor) != CACHE_MAGIC) { return 0; }
+    if (Util_LoadUint32(cursor + 4) != CACHE_VERSION) { return 0; }
+    Uint32 savedEntries = Util_LoadUint32(cursor + 8);
+    cursor += 12;
+
+    for (Uint32 i = 0; i < savedEntries; i++) {
+        CHECK_LEN(1);
+        Uint8 nameLen = *cursor++;
+        CHECK_LEN(nameLen + 18);
+        if (!nameLen || cursor[nameLen - 1]) { return 0; }
+        CacheEntry *entry = SoundCache_NewEntry();
+        memset(entry, 0, sizeof(CacheEntry));
+        entry->name = (char *)cursor;
+        cursor += nameLen;
+        entry->size = Util_LoadUint32(cursor);
+        entry->modTime = ((Uint64)Util_LoadUint32(cursor + 4) << 32) | Util_LoadUint32(cursor + 8);
+        entry->hash = Util_LoadUint32(cursor + 12);
+        entry->sound.isMusic = cursor[16];
+        entry->sound.count = cursor[17];
+        cursor += 18;
+        entry->sound.data = ommalloc(entry->sound.count * sizeof(Instrument));
+        for (int j = 0; j < entry->sound.count; j++) {
+            CHECK_LEN(8);
+            Instrument *inst = &entry->sound.data[j];
+            memset(inst, 0, sizeof(Instrument));
+            inst->num = cursor[0];
+            inst->channel = cursor[1];
+            inst->reg1 = cursor[2];
+            inst->reg0 = cursor[3];
+            Uint32 dataLen = Util_LoadUint32(cursor + 4);
+            cursor += 8;
+            CHECK_LEN(dataLen);
+            inst->data = cursor;
+            cursor += dataLen;
+        }
+    }
+#undef CHECK_LEN
+    return 1;
+}
+
+void SoundCache_Init(void) {
+    allocedEntries = 16;
+    entries = ommalloc(allocedEntries * sizeof(CacheEntry));
+    numEntries = 0;
+    dirty = 0;
+
+    FILE *fp = File_Open(CACHE_FILENAME, "rb");
+    if (fp) {
+        int cacheSize;
+        cacheData = File_Load(fp, &cacheSize);
+        fclose(fp);
+        if (!SoundCache_Parse(cacheSize)) {
+            // throw out the whole thing, it'll get rebuilt on the next save
+            for (int i = 0; i < numEntries; i++) {
+                free(entries[i].sound.data);
+            }
+            numEntries = 0;
+            dirty = 1;
+        }
+    }
+}
+
+int SoundCache_Find(const char *filename, Uint32 size, Uint64 modTime, Uint32 hash, Sound *sound) {
+    CacheEntry *entry = SoundCache_FindEntry(filename);
+    if (!entry || (entry->size != size) || (entry->modTime != modTime) || (entry->hash != hash)) {
+        return 0;
+    }
+
+    entry->used = 1;
+    // the engine modifies the Sound's instrument array (see the ROM sound
+    // patches), so give the caller its own copy
+    sound->isMusic = entry->sound.isMusic;
+    sound->count = entry->sound.count;
+    sound->data = ommalloc(sound->count * sizeof(Instrument));
+    memcpy(sound->data, entry->sound.data, sound->count * sizeof(Instrument));
+    return 1;
+}
+
+void SoundCache_Add(const char *filename, Uint32 size, Uint64 modTime, Uint32 hash, Sound *sound) {
+    CacheEntry *entry = SoundCache_FindEntry(filename);
+    if (entry) {
+        free(entry->sound.data);
+    }
+    else {
+        entry = SoundCache_NewEntry();
+        entry->name = ommalloc(strlen(filename) + 1);
+        strcpy(entry->name, filename);
+    }
+    entry->size = size;
+    entry->modTime = modTime;
+    entry->hash = hash;
+    entry->used = 1;
+    entry->sound.isMusic = sound->isMusic;
+    entry->sound.count = sound->count;
+    entry->sound.data = ommalloc(sound->count * sizeof(Instrument));
+    memcpy(entry->sound.data, sound->data, sound->count * sizeof(Instrument));
+    dirty = 1;
+}
+
+void SoundCache_Save(void) {
+    int savedEntries = 0;
+    for (int i = 0; i < numEntries; i++) {
+        if (entries[i].used) { savedEntries++; }
+    }
+    if (savedEntries != numEntries) { dirty = 1; }
+    if (!dirty) { return; }
+
+    // the cache is just an optimization, so failing to write it isn't an error
+    FILE *fp = File_Open(CACHE_FILENAME, "wb");
+    if (!fp) { return; }
+
+    File_WriteUint32BE(CACHE_MAGIC, fp);
+    File_WriteUint32BE(CACHE_VERSION, fp);
+    File_WriteUint32BE((Uint32)savedEntries, fp);
+    for (int i = 0; i < numEntries; i++) {
+        CacheEntry *entry = &entries[i];
+        if (!entry->used) { continue; }
+        // add 1 for the NUL terminator
+        Uint8 nameLen = (Uint8)strlen(entry->name) + 1;
+        fputc(nameLen, fp);
+        fwrite(entry->name, 1, nameLen, fp);
+        File_WriteUint32BE(entry->size, fp);
+        File_WriteUint32BE((Uint32)(entry->modTime >> 32), fp);
+        File_WriteUint32BE((Uint32)entry->modTime, fp);
+        File_WriteUint32BE(entry->hash, fp);
+        fputc(entry->sound.isMusic, fp);
+        fputc(entry->sound.count, fp);
+        for (int j = 0; j < entry->sound.count; j++) {
+            Instrument *inst = &entry->sound.data[j];
+            fputc(inst->num, fp);
+            fputc(inst->channel, fp);
+            fputc(inst->reg1, fp);
+            fputc(inst->reg0, fp);
+            Uint32 dataLen = SoundCache_DataLen(inst->data);
+            File_WriteUint32BE(dataLen, fp);
+            fwrite(inst->data, 1, dataLen, fp);
+        }
+    }
+    fclose(fp);
+    dirty = 0;
+}
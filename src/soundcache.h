@@ -0,0 +1,57 @@
+/* soundcache.h: Compiled MML cache
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "constants.h"
+#include "sound.h"
+
+/**
+ * @brief Loads the sound cache file from the user data directory. Should be
+ * run before any SoundCache_Find calls.
+ */
+void SoundCache_Init(void);
+
+/**
+ * @brief Looks for a cached compile of an MML file.
+ * @param filename MML file name (as passed to MML_Compile)
+ * @param size size of the MML file in bytes
+ * @param modTime modification time of the MML file
+ * @param hash hash of the MML file's contents (see Util_Hash)
+ * @param sound (out) where to write the sound metadata and bytecode
+ * @returns 1 if the sound was found in the cache, 0 otherwise
+ */
+int SoundCache_Find(const char *filename, Uint32 size, Uint64 modTime, Uint32 hash, Sound *sound);
+
+/**
+ * @brief Adds a freshly compiled MML file to the cache, replacing any
+ * outdated version of it.
+ * @param filename MML file name (as passed to MML_Compile)
+ * @param size size of the MML file in bytes
+ * @param modTime modification time of the MML file
+ * @param hash hash of the MML file's contents (see Util_Hash)
+ * @param sound the compiled sound. Its data must stay allocated until the
+ * cache gets saved.
+ */
+void SoundCache_Add(const char *filename, Uint32 size, Uint64 modTime, Uint32 hash, Sound *sound);
+
+/**
+ * @brief Writes the cache back to disk if anything changed. Entries that
+ * weren't looked up or added since SoundCache_Init are dropped.
+ */
+void SoundCache_Save(void);
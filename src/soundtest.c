@@ -81,6 +81,7 @@ void SoundTest_Run(void) {
 
 int SoundTest_RunStandaloneInit(char *mmlPath) {
     if (MML_Compile(mmlPath, &sounds[0])) {
+        Sound_Decode(&sounds[0]);
         BG_Clear();
         BG_SetAllPalettes(palette);
         BG_Print(8, 2, 0, "OpenMadoola MML");
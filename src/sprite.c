@@ -27,12 +27,27 @@
 #include "palette.h"
 #include "platform.h"
 #include "sprite.h"
+#include "util.h"
 
 static Sprite sprites[200];
+// the object slot that drew each sprite
+static Uint16 spriteObjects[ARRAY_LEN(sprites)];
 static Sprite overlaySprites[200];
 
 static int spriteCursor;
 static int overlayCursor;
+// alternates every frame, see Sprite_Display
+static int drawOrder = 0;
+// number of sprites that didn't fit in each list
+static int spriteOverflows = 0;
+static int overlayOverflows = 0;
+
+static void Sprite_Overflow(void) {
+    // only show the error once so it doesn't pop up every frame
+    if (!spriteOverflows++) {
+        Platform_ShowError("Not enough sprites, increase size of sprites array in sprite.c");
+    }
+}
 
 void Sprite_SetPalette(int palnum, const Uint8 *palette) {
     memcpy(&colorPalette[(palnum + 4) * PALETTE_SIZE], palette, PALETTE_SIZE);
@@ -76,13 +91,76 @@ void Sprite_ClearOverlayList(void) {
     overlayCursor = 0;
 }
 
+int Sprite_Count(void) {
+    return spriteCursor;
+}
+
+void Sprite_GetOverflows(int *spriteCount, int *overlayCount) {
+    *spriteCount = spriteOverflows;
+    *overlayCount = overlayOverflows;
+}
+
+void Sprite_SaveSnapshot(Buffer *buf) {
+    Buffer_AddData(buf, (Uint8 *)&spriteCursor, sizeof(spriteCursor));
+    Buffer_AddData(buf, (Uint8 *)&overlayCursor, sizeof(overlayCursor));
+    Buffer_AddData(buf, (Uint8 *)&drawOrder, sizeof(drawOrder));
+    Buffer_AddData(buf, (Uint8 *)sprites, spriteCursor * sizeof(Sprite));
+    Buffer_AddData(buf, (Uint8 *)spriteObjects, spriteCursor * sizeof(Uint16));
+    Buffer_AddData(buf, (Uint8 *)overlaySprites, overlayCursor * sizeof(Sprite));
+}
+
+int Sprite_LoadSnapshot(Buffer *buf, int index) {
+    Buffer_ReadData(buf, index, &spriteCursor, sizeof(spriteCursor));
+    index += sizeof(spriteCursor);
+    Buffer_ReadData(buf, index, &overlayCursor, sizeof(overlayCursor));
+    index += sizeof(overlayCursor);
+    Buffer_ReadData(buf, index, &drawOrder, sizeof(drawOrder));
+    index += sizeof(drawOrder);
+    Buffer_ReadData(buf, index, sprites, spriteCursor * sizeof(Sprite));
+    index += spriteCursor * sizeof(Sprite);
+    Buffer_ReadData(buf, index, spriteObjects, spriteCursor * sizeof(Uint16));
+    index += spriteCursor * sizeof(Uint16);
+    Buffer_ReadData(buf, index, overlaySprites, overlayCursor * sizeof(Sprite));
+    index += overlayCursor * sizeof(Sprite);
+    return index;
+}
+
+void Sprite_SortByObject(int start) {
+    // insertion sort, because the list is almost always nearly sorted already
+    for (int i = start + 1; i < spriteCursor; i++) {
+        Sprite spr = sprites[i];
+        Uint16 slot = spriteObjects[i];
+        int j = i;
+        while ((j > start) && (spriteObjects[j - 1] > slot)) {
+            sprites[j] = sprites[j - 1];
+            spriteObjects[j] = spriteObjects[j - 1];
+            j--;
+        }
+        sprites[j] = spr;
+        spriteObjects[j] = slot;
+    }
+}
+
+Uint64 Sprite_Hash(Uint64 hash) {
+    for (int i = 0; i < spriteCursor; i++) {
+        Sprite *spr = &sprites[i];
+        Uint8 data[9] = {
+            spr->x & 0xff, spr->x >> 8, spr->y & 0xff, spr->y >> 8, spr->size,
+            spr->tile & 0xff, spr->tile >> 8, spr->palette, spr->mirror,
+        };
+        hash = Util_Hash64(hash, data, sizeof(data));
+    }
+    return hash;
+}
+
 Sprite *Sprite_Get(void) {
     if (spriteCursor >= ARRAY_LEN(sprites)) {
-        Platform_ShowError("Not enough sprites, increase size of sprites array in sprite.c");
+        Sprite_Overflow();
         return NULL;
     }
 
     Sprite *spr = sprites + spriteCursor;
+    spriteObjects[spriteCursor] = (Uint16)currObjectIndex;
     spriteCursor++;
     // initialize the sprite to be offscreen
     spr->y = 0xffe0;
@@ -123,10 +201,11 @@ void Sprite_Draw(Sprite *s, Object *o) {
     }
 
     if (spriteCursor < ARRAY_LEN(sprites)) {
+        spriteObjects[spriteCursor] = (Uint16)currObjectIndex;
         sprites[spriteCursor++] = *s;
     }
     else {
-        Platform_ShowError("Not enough sprites, increase size of sprites array in sprite.c");
+        Sprite_Overflow();
     }
 }
 
@@ -205,7 +284,7 @@ void Sprite_DrawOverlay(Sprite *s) {
     if (overlayCursor < ARRAY_LEN(overlaySprites)) {
         overlaySprites[overlayCursor++] = *s;
     }
-    else {
+    else if (!overlayOverflows++) {
         Platform_ShowError("Not enough sprites, increase size of overlaySprites array in sprite.c");
     }
 }
@@ -229,16 +308,16 @@ static void Sprite_DisplayInternal(Sprite *spr) {
 }
 
 void Sprite_Display(void) {
-    static int drawOrder = 0;
-
-    if (drawOrder) {
-        for (int i = (spriteCursor - 1); i >= 0; i--) {
-            Sprite_DisplayInternal(sprites + i);
+    if (renderFrame) {
+        if (drawOrder) {
+            for (int i = (spriteCursor - 1); i >= 0; i--) {
+                Sprite_DisplayInternal(sprites + i);
+            }
         }
-    }
-    else {
-        for (int i = 0; i < spriteCursor; i++) {
-            Sprite_DisplayInternal(sprites + i);
+        else {
+            for (int i = 0; i < spriteCursor; i++) {
+                Sprite_DisplayInternal(sprites + i);
+            }
         }
     }
     // alternate sprite draw order every frame (this makes sprites "transparent" if
@@ -247,6 +326,8 @@ void Sprite_Display(void) {
 }
 
 void Sprite_DisplayOverlay(void) {
+    if (!renderFrame) { return; }
+
     for (int i = 0; i < overlayCursor; i++) {
         Sprite_DisplayInternal(overlaySprites + i);
     }
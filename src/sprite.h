@@ -61,6 +61,47 @@ void Sprite_ClearList(void);
  */
 void Sprite_ClearOverlayList(void);
 
+/**
+ * @returns the number of sprites in the sprite list
+ */
+int Sprite_Count(void);
+
+/**
+ * @brief Gets how many sprites have been dropped because the sprite lists
+ * were full (since the game started).
+ * @param spriteCount where to write the number of dropped sprites
+ * @param overlayCount where to write the number of dropped overlay sprites
+ */
+void Sprite_GetOverflows(int *spriteCount, int *overlayCount);
+
+/**
+ * @brief Adds the sprite lists to a state snapshot
+ * @param buf buffer to add to
+ */
+void Sprite_SaveSnapshot(Buffer *buf);
+
+/**
+ * @brief Restores the sprite lists from a state snapshot
+ * @param buf buffer to read from
+ * @param index where the sprite state starts in the buffer
+ * @returns the index right after the sprite state
+ */
+int Sprite_LoadSnapshot(Buffer *buf, int index);
+
+/**
+ * @brief Sorts the sprite list by the slot number of the object that drew
+ * each sprite. Sprites with the same object keep their order.
+ * @param start first sprite in the list to sort
+ */
+void Sprite_SortByObject(int start);
+
+/**
+ * @brief Adds the contents of the sprite list to a hash.
+ * @param hash the hash to add to
+ * @returns the updated hash
+ */
+Uint64 Sprite_Hash(Uint64 hash);
+
 /**
  * @brief Gets the next free sprite in the sprite list.
  * Note that this will get overwritten every frame unless you don't call Sprite_ClearList.
@@ -0,0 +1,147 @@
+/* state.c: Game state snapshots
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <assert.h>
+
+#include "buffer.h"
+#include "camera.h"
+#include "constants.h"
+#include "daltos.h"
+#include "game.h"
+#include "item.h"
+#include "lucia.h"
+#include "map.h"
+#include "object.h"
+#include "palette.h"
+#include "rng.h"
+#include "sound.h"
+#include "sprite.h"
+#include "state.h"
+#include "weapon.h"
+
+// "OMST"
+#define STATE_MAGIC 0x4f4d5354
+// bump this whenever the state layout changes
+#define STATE_VERSION 5
+
+typedef struct {
+    Uint32 magic;
+    Uint32 version;
+    Uint32 session;
+    Uint32 flags;
+} StateHeader;
+
+typedef struct {
+    void *ptr;
+    int size;
+} StateVar;
+
+#define STATE_VAR(var) {&(var), sizeof(var)}
+
+// globals that belong to modules without any private state. modules with
+// private state save it themselves (Object_SaveSnapshot, etc.)
+static const StateVar stateVars[] = {
+    // camera.c
+    STATE_VAR(cameraX),
+    STATE_VAR(cameraY),
+    STATE_VAR(scrollMode),
+    // rng.c
+    STATE_VAR(rngVal),
+    // weapon.c
+    STATE_VAR(weaponLevels),
+    STATE_VAR(currentWeapon),
+    STATE_VAR(weaponDamage),
+    STATE_VAR(weaponCoords),
+    // lucia.c
+    STATE_VAR(bootsLevel),
+    STATE_VAR(attackTimer),
+    STATE_VAR(hasWing),
+    STATE_VAR(usingWing),
+    STATE_VAR(luciaDoorFlag),
+    STATE_VAR(luciaHurtPoints),
+    STATE_VAR(health),
+    STATE_VAR(maxHealth),
+    STATE_VAR(healthTimer),
+    STATE_VAR(magic),
+    STATE_VAR(maxMagic),
+    STATE_VAR(lives),
+    STATE_VAR(luciaXPos),
+    STATE_VAR(luciaYPos),
+    STATE_VAR(luciaSpriteX),
+    STATE_VAR(luciaSpriteY),
+    STATE_VAR(luciaMetatile),
+    // daltos.c
+    STATE_VAR(daltosKilled),
+    // item.c
+    STATE_VAR(itemsCollected),
+};
+
+int State_Available(void) {
+    return Game_AtFrameBoundary();
+}
+
+int State_Save(Buffer *buf, int flags) {
+    if (!State_Available()) { return 0; }
+
+    buf->dataSize = 0;
+    StateHeader header = {STATE_MAGIC, STATE_VERSION, Game_SessionNum(), (Uint32)flags};
+    Buffer_AddData(buf, (Uint8 *)&header, sizeof(header));
+    for (int i = 0; i < ARRAY_LEN(stateVars); i++) {
+        Buffer_AddData(buf, stateVars[i].ptr, stateVars[i].size);
+    }
+    Game_SaveSnapshot(buf);
+    Object_SaveSnapshot(buf);
+    Map_SaveSnapshot(buf);
+    Palette_SaveSnapshot(buf);
+    Sprite_SaveSnapshot(buf);
+    if (!(flags & STATE_NO_SOUND)) {
+        Sound_SaveSnapshot(buf);
+    }
+    return 1;
+}
+
+int State_Load(Buffer *buf) {
+    if (!State_Available()) { return 0; }
+    if (buf->dataSize < (int)sizeof(StateHeader)) { return 0; }
+
+    StateHeader header;
+    Buffer_ReadData(buf, 0, &header, sizeof(header));
+    if ((header.magic != STATE_MAGIC) || (header.version != STATE_VERSION) ||
+        (header.session != Game_SessionNum()))
+    {
+        return 0;
+    }
+
+    int index = sizeof(header);
+    for (int i = 0; i < ARRAY_LEN(stateVars); i++) {
+        Buffer_ReadData(buf, index, stateVars[i].ptr, stateVars[i].size);
+        index += stateVars[i].size;
+    }
+    index = Game_LoadSnapshot(buf, index);
+    index = Object_LoadSnapshot(buf, index);
+    // loading the map can reload the room palette, so do it before the palette
+    index = Map_LoadSnapshot(buf, index);
+    index = Palette_LoadSnapshot(buf, index);
+    index = Sprite_LoadSnapshot(buf, index);
+    if (!(header.flags & STATE_NO_SOUND)) {
+        index = Sound_LoadSnapshot(buf, index);
+    }
+    assert(index == buf->dataSize);
+    return 1;
+}
@@ -0,0 +1,56 @@
+/* state.h: Game state snapshots
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include "buffer.h"
+
+/**
+ * @brief Checks if the game state can be saved or loaded right now. States
+ * only capture global variables, so they can only be taken while the game task
+ * is waiting at the frame boundary in the stage loop (not paused, and not in
+ * a child task like the keyword screen).
+ * @returns 1 if State_Save/State_Load can be used, 0 otherwise
+ */
+int State_Available(void);
+
+typedef enum {
+    // leave out the sound engine. for states that get loaded back while the
+    // sound engine keeps running (run-ahead), where loading it would replay
+    // the music ticks that ran in between
+    STATE_NO_SOUND = (1 << 0),
+} StateFlags;
+
+/**
+ * @brief Saves the current game state. The state is in native byte order and
+ * is only valid for the game session it was saved in, so it shouldn't be
+ * written to disk.
+ * @param buf Buffer to save the state to (any existing contents are replaced)
+ * @param flags StateFlags values ORed together (0 for a full state)
+ * @returns 1 on success, 0 if the state isn't available right now
+ */
+int State_Save(Buffer *buf, int flags);
+
+/**
+ * @brief Restores a game state saved by State_Save. Anything left out by the
+ * flags it was saved with is left alone.
+ * @param buf Buffer holding the state
+ * @returns 1 on success, 0 if the state isn't available right now or buf
+ * wasn't saved during the current game session
+ */
+int State_Load(Buffer *buf);
@@ -18,10 +18,17 @@
  */
 
 #include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
 #include "db.h"
 #include "game.h"
+#include "graphics.h"
 #include "highscore.h"
+#include "input.h"
 #include "joy.h"
+#include "nanotime.h"
+#include "object.h"
 #include "palette.h"
 #include "platform.h"
 #include "rng.h"
@@ -47,17 +54,73 @@ int System_Init(void) {
     Save_Init();
     HighScore_Init();
     Joy_Init();
+    Object_ListInit();
     RNG_Seed();
+#ifdef OM_OBJECT_PROFILE
+    atexit(Object_ProfileDump);
+#endif
     return 1;
 }
 
+void System_EnableLatency(void) {
+    atexit(Platform_PrintLatency);
+    atexit(Input_PrintLatency);
+}
+
+// how many frames to run for each frame that gets presented (0 = max speed)
+static int speed = 1;
+// at max speed, keep running frames for this long before presenting one
+#define MAX_SPEED_NS (12 * 1000000)
+
+// run after every frame that gets drawn
+static void (*frameFunc)(void) = NULL;
+
+void System_SetSpeed(int frames) {
+    speed = frames;
+}
+
+void System_SetFrameFunc(void (*func)(void)) {
+    frameFunc = func;
+}
+
 void System_GameLoop(void) {
+    Uint64 fpsStart = nanotime_now();
+    int fpsFrames = 0;
+
     while (1) {
         Platform_StartFrame();
-        Graphics_StartFrame();
-        Joy_Update();
-        Task_Run();
-        Sound_Run();
+        Object_ProfileUpdate();
+        Uint64 start = nanotime_now();
+        int count = 0;
+        // only draw the last frame before presenting. the sound engine only
+        // runs when the audio queue needs more samples, so the extra calls to
+        // Sound_Run return early and the audio keeps playing at normal speed.
+        int lastFrame;
+        do {
+            count++;
+            lastFrame = speed ? (count >= speed) : ((nanotime_now() - start) >= MAX_SPEED_NS);
+            renderFrame = lastFrame && !Platform_SkippingFrame();
+            Graphics_StartFrame();
+            Joy_Update();
+            Task_Run();
+            if (renderFrame && frameFunc) { frameFunc(); }
+            Sound_Run();
+        } while (!lastFrame);
         Platform_EndFrame();
+
+        // show the frame rate while running faster than normal
+        if (count > 1) {
+            fpsFrames += count;
+            Uint64 now = nanotime_now();
+            if ((now - fpsStart) >= NANOTIME_NSEC_PER_SEC) {
+                printf("Running at %.1f fps\n", (double)fpsFrames * NANOTIME_NSEC_PER_SEC / (now - fpsStart));
+                fpsStart = now;
+                fpsFrames = 0;
+            }
+        }
+        else {
+            fpsStart = nanotime_now();
+            fpsFrames = 0;
+        }
     }
 }
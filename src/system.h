@@ -25,6 +25,25 @@
  */
 int System_Init(void);
 
+/**
+ * @brief Prints the input latency stats when the program exits.
+ */
+void System_EnableLatency(void);
+
+/**
+ * @brief Sets how fast the game runs.
+ * @param frames number of frames to run for each presented frame, or 0 to run
+ * as many frames as possible
+ */
+void System_SetSpeed(int frames);
+
+/**
+ * @brief Sets a function to run at the end of every frame that gets drawn,
+ * after the framebuffer is finished.
+ * @param func the function to run, or NULL for none
+ */
+void System_SetFrameFunc(void (*func)(void));
+
 /**
  * @brief Runs platform code and jumps to the current task.
  */
@@ -18,6 +18,7 @@
  */
 
 #include "constants.h"
+#include "util.h"
 
 void Util_SaveUint16(Uint16 num, Uint8 *out) {
     out[0] = (num >> 8) & 0xff;
@@ -60,3 +61,21 @@ void Util_SaveSint32(Sint32 num, Uint8 *out) {
 Sint32 Util_LoadSint32(Uint8 *buff) {
     return (Sint32)Util_LoadUint32(buff);
 }
+
+Uint32 Util_Hash(Uint32 hash, const void *data, int len) {
+    const Uint8 *bytes = (const Uint8 *)data;
+    for (int i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+Uint64 Util_Hash64(Uint64 hash, const void *data, int len) {
+    const Uint8 *bytes = (const Uint8 *)data;
+    for (int i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
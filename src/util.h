@@ -75,3 +75,29 @@ void Util_SaveSint32(Sint32 num, Uint8 *out);
  * @returns the number
  */
 Sint32 Util_LoadSint32(Uint8 *buff);
+
+// starting value for Util_Hash
+#define UTIL_HASH_INIT 2166136261u
+
+/**
+ * @brief Hashes a block of data (32-bit FNV-1a). Can be chained across
+ * multiple blocks by passing the previous result back in as hash.
+ * @param hash UTIL_HASH_INIT, or the result of a previous Util_Hash call
+ * @param data the data to hash
+ * @param len length of the data in bytes
+ * @returns the new hash value
+ */
+Uint32 Util_Hash(Uint32 hash, const void *data, int len);
+
+// starting value for Util_Hash64
+#define UTIL_HASH64_INIT 14695981039346656037ull
+
+/**
+ * @brief 64-bit version of Util_Hash (64-bit FNV-1a), for when collisions
+ * matter more.
+ * @param hash UTIL_HASH64_INIT, or the result of a previous Util_Hash64 call
+ * @param data the data to hash
+ * @param len length of the data in bytes
+ * @returns the new hash value
+ */
+Uint64 Util_Hash64(Uint64 hash, const void *data, int len);
@@ -0,0 +1,356 @@
+/* verify.c: Parallel demo verification
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+// first because it contains the OM_UNIX define
+#include "constants.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef OM_UNIX
+#include <dirent.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "alloc.h"
+#include "demo.h"
+#include "game.h"
+#include "hashlog.h"
+#include "nanotime.h"
+#include "platform.h"
+#include "sound.h"
+#include "system.h"
+#include "task.h"
+#include "verify.h"
+
+// every demo being verified, sorted so they get split up the same way each run
+static char **demoFilenames = NULL;
+static int numDemos = 0;
+// worker process n plays demos n, n + numWorkers, n + numWorkers * 2...
+static int workerNum;
+static int numWorkers;
+// where the worker process sends its hashes
+static FILE *workerFile = NULL;
+static char *workerDemo;
+// when set, the expected hashes get (re)written instead of checked
+static int recording;
+
+static void Verify_DemoTask(void) {
+    Game_PlayDemo(workerDemo);
+}
+
+void Verify_WorkerTask(void) {
+    // worker protocol: "demo <number>", then one state hash per line (written
+    // by the hash log), then "end"
+    for (int i = workerNum; i < numDemos; i += numWorkers) {
+        workerDemo = demoFilenames[i];
+        fprintf(workerFile, "demo %d\n", i);
+        int frames = Demo_Length(workerDemo);
+        // a timer of 0 would play forever
+        if (frames) {
+            Task_Child(Verify_DemoTask, frames, 0);
+            Demo_Uninit();
+            Sound_Reset();
+        }
+        fprintf(workerFile, "end\n");
+        fflush(workerFile);
+    }
+    HashLog_SetFile(NULL);
+    fclose(workerFile);
+    Platform_Quit();
+}
+
+#ifdef OM_UNIX
+typedef struct {
+    int fd;
+    pid_t pid;
+    // partial line read from the pipe
+    char line[64];
+    int lineLen;
+    // demo the hashes are for, or -1 if between demos
+    int demo;
+    Uint64 *hashes;
+    int numHashes;
+    int hashCapacity;
+} Worker;
+
+static int Verify_CompareFilenames(const void *a, const void *b) {
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int Verify_FindDemos(const char *dir) {
+    DIR *dp = opendir(dir);
+    if (!dp) {
+        fprintf(stderr, "Couldn't open directory %s.\n", dir);
+        return 0;
+    }
+
+    int capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dp))) {
+        size_t len = strlen(entry->d_name);
+        if ((len <= 4) || strcmp(entry->d_name + len - 4, ".dem")) { continue; }
+        if (numDemos == capacity) {
+            capacity = capacity ? (capacity * 2) : 64;
+            demoFilenames = omrealloc(demoFilenames, capacity * sizeof(char *));
+        }
+        char *filename = ommalloc(strlen(dir) + 1 + len + 1);
+        sprintf(filename, "%s/%s", dir, entry->d_name);
+        demoFilenames[numDemos++] = filename;
+    }
+    closedir(dp);
+
+    if (!numDemos) {
+        fprintf(stderr, "No demos found in %s.\n", dir);
+        return 0;
+    }
+    qsort(demoFilenames, numDemos, sizeof(char *), Verify_CompareFilenames);
+    return numDemos;
+}
+
+// returns 1 if the hashes match the demo's expected hashes
+static int Verify_CheckDemo(int demo, const Uint64 *hashes, int count) {
+    const char *filename = demoFilenames[demo];
+    if (!count) {
+        printf("%s: couldn't play demo\n", filename);
+        return 0;
+    }
+
+    // expected hashes are the demo filename with the extension swapped out
+    const char *ext = strrchr(filename, '.');
+    int baseLen = (int)(ext - filename);
+    char *expectedFilename = ommalloc(baseLen + sizeof(".hashes"));
+    sprintf(expectedFilename, "%.*s.hashes", baseLen, filename);
+
+    // read one extra hash so we can tell if the expected hashes are longer
+    Uint64 *expected = ommalloc((count + 1) * sizeof(Uint64));
+    int expectedCount = recording ? -1 : HashLog_Load(expectedFilename, expected, count + 1);
+    int ok = 1;
+    if (expectedCount < 0) {
+        if (HashLog_Save(expectedFilename, hashes, count)) {
+            printf("%s: recorded %s (%d frames)\n", filename, expectedFilename, count);
+            // nothing got compared, so it only passes if recording was asked for
+            ok = recording;
+        }
+        else {
+            ok = 0;
+        }
+    }
+    else {
+        int frames = MIN(count, expectedCount);
+        int mismatch = -1;
+        for (int frame = 0; frame < frames; frame++) {
+            if (hashes[frame] != expected[frame]) {
+                mismatch = frame;
+                break;
+            }
+        }
+        if (mismatch >= 0) {
+            printf("%s: FAILED, state differs at frame %d (%016" PRIx64 " vs %016" PRIx64 ")\n",
+                   filename, mismatch, expected[mismatch], hashes[mismatch]);
+            ok = 0;
+        }
+        else if (expectedCount > count) {
+            printf("%s: FAILED, demo ended early (%d frames)\n", filename, count);
+            ok = 0;
+        }
+        else if (expectedCount < count) {
+            printf("%s: FAILED, demo lengths differ (%d vs %d frames)\n", filename, expectedCount, count);
+            ok = 0;
+        }
+        else {
+            printf("%s: OK (%d frames)\n", filename, count);
+        }
+    }
+    free(expected);
+    free(expectedFilename);
+    return ok;
+}
+
+// results: 0 = demo not finished, 1 = passed, -1 = failed
+static void Verify_ParseLine(Worker *worker, int *results) {
+    worker->line[worker->lineLen] = '\0';
+    worker->lineLen = 0;
+
+    // check these first, "demo" and "end" start with hex digits
+    int demo;
+    Uint64 hash;
+    if (sscanf(worker->line, "demo %d", &demo) == 1) {
+        worker->demo = ((demo >= 0) && (demo < numDemos)) ? demo : -1;
+        worker->numHashes = 0;
+    }
+    else if (strcmp(worker->line, "end") == 0) {
+        if (worker->demo >= 0) {
+            results[worker->demo] = Verify_CheckDemo(worker->demo, worker->hashes, worker->numHashes) ? 1 : -1;
+            fflush(stdout);
+        }
+        worker->demo = -1;
+    }
+    else if ((worker->demo >= 0) && (sscanf(worker->line, "%" SCNx64, &hash) == 1)) {
+        if (worker->numHashes == worker->hashCapacity) {
+            worker->hashCapacity = worker->hashCapacity ? (worker->hashCapacity * 2) : 4096;
+            worker->hashes = omrealloc(worker->hashes, worker->hashCapacity * sizeof(Uint64));
+        }
+        worker->hashes[worker->numHashes++] = hash;
+    }
+}
+
+// sets up the worker process's state, returns 1 on success
+static int Verify_StartWorker(int num, int fd) {
+    workerNum = num;
+    workerFile = fdopen(fd, "w");
+    if (!workerFile) { return 0; }
+    HashLog_SetFile(workerFile);
+    // the workers' own output (fps counter etc) would clutter up the results
+    if (!freopen("/dev/null", "w", stdout)) { return 0; }
+    // run headless and as fast as possible
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    setenv("SDL_AUDIODRIVER", "dummy", 0);
+    System_SetSpeed(0);
+    return 1;
+}
+#endif
+
+int Verify_Run(const char *dir, int jobs, int record) {
+#ifdef OM_UNIX
+    recording = record;
+    if (!Verify_FindDemos(dir)) { return -1; }
+
+    Uint64 start = nanotime_now();
+    numWorkers = MIN(jobs, numDemos);
+    Worker *workers = ommalloc(numWorkers * sizeof(Worker));
+    int *results = ommalloc(numDemos * sizeof(int));
+    memset(results, 0, numDemos * sizeof(int));
+    // anything still buffered would get printed again by every worker
+    fflush(stdout);
+    fflush(stderr);
+
+    int started = 0;
+    for (; started < numWorkers; started++) {
+        int fds[2];
+        if (pipe(fds)) {
+            perror("Couldn't create pipe");
+            break;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            perror("Couldn't start worker");
+            close(fds[0]);
+            close(fds[1]);
+            break;
+        }
+        if (pid == 0) {
+            // the other workers' pipes belong to the main process
+            for (int i = 0; i < started; i++) {
+                close(workers[i].fd);
+            }
+            close(fds[0]);
+            free(workers);
+            free(results);
+            if (!Verify_StartWorker(started, fds[1])) { _exit(1); }
+            return VERIFY_WORKER;
+        }
+        close(fds[1]);
+        memset(&workers[started], 0, sizeof(Worker));
+        workers[started].fd = fds[0];
+        workers[started].pid = pid;
+        workers[started].demo = -1;
+    }
+    // if not every worker could start, the leftover demos never finish and
+    // get reported as failures below
+    numWorkers = started;
+
+    // read hashes from every worker until they all close their pipes
+    struct pollfd *pollFds = ommalloc(numWorkers * sizeof(struct pollfd));
+    for (int i = 0; i < numWorkers; i++) {
+        pollFds[i].fd = workers[i].fd;
+        pollFds[i].events = POLLIN;
+    }
+    int openPipes = numWorkers;
+    while (openPipes) {
+        if (poll(pollFds, numWorkers, -1) < 0) {
+            if (errno == EINTR) { continue; }
+            perror("Couldn't read from workers");
+            break;
+        }
+        for (int i = 0; i < numWorkers; i++) {
+            if (!pollFds[i].revents) { continue; }
+            char buff[4096];
+            ssize_t len = read(pollFds[i].fd, buff, sizeof(buff));
+            if ((len < 0) && (errno == EINTR)) { continue; }
+            if (len <= 0) {
+                close(pollFds[i].fd);
+                // poll ignores negative fds
+                pollFds[i].fd = -1;
+                openPipes--;
+                continue;
+            }
+            Worker *worker = &workers[i];
+            for (ssize_t j = 0; j < len; j++) {
+                if (buff[j] == '\n') {
+                    Verify_ParseLine(worker, results);
+                }
+                else if (worker->lineLen < (int)(sizeof(worker->line) - 1)) {
+                    worker->line[worker->lineLen++] = buff[j];
+                }
+            }
+        }
+    }
+
+    int failed = 0;
+    for (int i = 0; i < numWorkers; i++) {
+        int status;
+        waitpid(workers[i].pid, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            printf("Worker %d exited abnormally\n", i);
+            failed = 1;
+        }
+        free(workers[i].hashes);
+    }
+    for (int i = 0; i < numDemos; i++) {
+        if (!results[i]) {
+            printf("%s: FAILED, worker quit before finishing the demo\n", demoFilenames[i]);
+        }
+        if (results[i] <= 0) { failed = 1; }
+    }
+    printf("%s %d demos with %d workers in %.1f seconds: %s\n",
+           recording ? "Recorded" : "Verified", numDemos, numWorkers,
+           (double)(nanotime_now() - start) / 1000000000.0, failed ? "failed" : "passed");
+
+    free(pollFds);
+    free(results);
+    free(workers);
+    for (int i = 0; i < numDemos; i++) {
+        free(demoFilenames[i]);
+    }
+    free(demoFilenames);
+    return failed;
+#else
+    (void)dir;
+    (void)jobs;
+    (void)record;
+    fprintf(stderr, "Demo verification needs fork(), which isn't available on this platform.\n");
+    return -1;
+#endif
+}
@@ -0,0 +1,46 @@
+/* verify.h: Parallel demo verification
+ * Copyright (c) 2026 Nathan Misner
+ *
+ * This file is part of OpenMadoola.
+ *
+ * OpenMadoola is free software: you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * OpenMadoola is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with OpenMadoola. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+// returned by Verify_Run in the worker processes
+#define VERIFY_WORKER (2)
+
+/**
+ * @brief Replays every demo (.dem file) in a directory and compares the game
+ * state hash of every frame against the demo's expected hashes (the demo
+ * filename with .hashes instead of .dem). Missing expected hashes get
+ * written, but count as a failure unless recording. The demos are split up
+ * between several worker processes, which send their hashes back over pipes.
+ * Must be called before System_Init.
+ * @param dir the directory with the demos
+ * @param jobs how many worker processes to run at once
+ * @param record 1 to write every demo's expected hashes instead of checking them
+ * @returns VERIFY_WORKER in the worker processes, which should then start up
+ * the game and run Verify_WorkerTask. In the main process, returns 0 if every
+ * demo matched, 1 if any didn't, and -1 if the demos couldn't be played.
+ */
+int Verify_Run(const char *dir, int jobs, int record);
+
+/**
+ * @brief Plays the worker process's demos and sends their state hashes to
+ * the main process, then quits. Should only be run (as a task) in a worker
+ * process after Verify_Run.
+ */
+void Verify_WorkerTask(void);
@@ -52,7 +52,7 @@ static Uint16 weaponMagicTbl[] = {
     500,    // flash
 };
 
-WeaponCoords weaponCoords[MAX_WEAPONS];
+WeaponCoords weaponCoords;
 
 static void Weapon_InitSword(void);
 static void Weapon_InitFlameSword(void);
@@ -69,10 +69,8 @@ void Weapon_Init(void) {
     }
 
     // set all weapon coordinates to "not spawned"
-    for (int i = 0; i < MAX_WEAPONS; i++) {
-        weaponCoords[i].spawned = 0;
-        weaponCoords[i].collided = 0;
-    }
+    weaponCoords.spawned = 0;
+    weaponCoords.collided = 0;
 }
 
 void Weapon_Process(void) {
@@ -285,13 +283,14 @@ static void Weapon_InitFlash(void) {
 
 int Weapon_SetCollisionCoords(Sint16 x, Sint16 y) {
     int index = (currObjectIndex - 1) & 7;
-    Uint8 lastCollided = weaponCoords[index].collided;
+    Uint8 bit = 1 << index;
+    int lastCollided = (weaponCoords.collided & bit) != 0;
 
-    weaponCoords[index].x = x;
+    weaponCoords.x[index] = x;
     // sprites are 8x16 so this gets the center
-    weaponCoords[index].y = y + 8;
-    weaponCoords[index].spawned = 1;
-    weaponCoords[index].collided = 0;
+    weaponCoords.y[index] = y + 8;
+    weaponCoords.spawned |= bit;
+    weaponCoords.collided &= ~bit;
 
     return lastCollided;
 }
@@ -300,5 +299,5 @@ void Weapon_EraseCollisionCoords(void) {
     // set weapon pos off the map
     Weapon_SetCollisionCoords(0, roomHeightMetatiles * METATILE_SIZE);
     int index = (currObjectIndex - 1) & 7;
-    weaponCoords[index].spawned = 0;
+    weaponCoords.spawned &= ~(1 << index);
 }
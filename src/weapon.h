@@ -32,20 +32,24 @@ typedef enum {
     NUM_WEAPONS,
 } WEAPON_NUMS;
 
+// maximum number of weapon objects
+#define MAX_WEAPONS (8)
+
+// Weapon hitbox positions, stored as arrays so Collision_Handle can check an
+// enemy against every weapon at once.
 typedef struct {
+    Sint16 x[MAX_WEAPONS];
+    Sint16 y[MAX_WEAPONS];
+    // bit n set = weapon n is spawned
     Uint8 spawned;
+    // bit n set = weapon n hit an enemy
     Uint8 collided;
-    Sint16 x;
-    Sint16 y;
 } WeaponCoords;
 
-// maximum number of weapon objects
-#define MAX_WEAPONS (8)
-
 extern Uint8 weaponLevels[NUM_WEAPONS];
 extern Uint8 currentWeapon;
 extern Uint8 weaponDamage;
-extern WeaponCoords weaponCoords[MAX_WEAPONS];
+extern WeaponCoords weaponCoords;
 
 /**
  * @brief Clears all weapon objects and collision coordinates